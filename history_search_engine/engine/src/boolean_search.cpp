@@ -1,195 +1,361 @@
 #include "boolean_search.h"
 #include <algorithm>
-#include <sstream>
-#include <cctype>
-
-BooleanSearch::BooleanSearch(InvertedIndex* idx, Stemmer* stem) 
-    : index(idx), stemmer(stem) {}
-
-std::vector<QueryToken> BooleanSearch::parseQuery(const std::string& query) {
-    std::vector<QueryToken> tokens;
-    std::istringstream iss(query);
-    std::string word;
-    Operator current_op = Operator::NONE;
-    
-    while (iss >> word) {
-        std::string upper = word;
-        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
-        
-        if (upper == "AND") {
-            current_op = Operator::AND;
-        } else if (upper == "OR") {
-            current_op = Operator::OR;
-        } else if (upper == "NOT") {
-            current_op = Operator::NOT;
-        } else {
-            QueryToken token;
-            token.term = word;
-            token.op = current_op;
-            tokens.push_back(token);
-            current_op = Operator::AND;
-        }
+#include <cmath>
+
+BooleanSearch::BooleanSearch(InvertedIndex* idx, size_t cache_bytes)
+    : index(idx), segments(nullptr), planner(&stems), cache(cache_bytes) {}
+
+BooleanSearch::BooleanSearch(SegmentedIndex* idx, size_t cache_bytes)
+    : index(nullptr), segments(idx), planner(&stems), cache(cache_bytes) {}
+
+IndexSnapshot BooleanSearch::snapshot() const {
+    if (segments) return segments->snapshot();
+    
+    IndexSnapshot single;
+    single.segments.push_back({index, nullptr, 0});
+    single.generation = index->getGeneration();
+    single.total_docs = index->getTotalDocuments();
+    return single;
+}
+
+bool BooleanSearch::usesPositions(const QueryNode* node) {
+    if (!node) return false;
+    if (node->type == QueryNodeType::PHRASE || node->type == QueryNodeType::NEAR) return true;
+    for (const auto& child : node->children) {
+        if (usesPositions(child.get())) return true;
     }
+    return false;
+}
+
+std::unique_ptr<QueryNode> BooleanSearch::parseQuery(const std::string& query,
+                                                     const IndexSnapshot& snapshot) {
+    auto tree = parser.parse(query);
+    query_error = parser.getError();
+    query_warning.clear();
+    if (!query_error.empty() || !usesPositions(tree.get())) return tree;
     
-    return tokens;
+    for (const auto& segment : snapshot.segments) {
+        if (segment.index->getVocabularySize() > 0 && !segment.index->storesPositions()) {
+            query_warning = "the index has no positions; phrases and NEAR were matched as AND";
+            break;
+        }
+    }
+    return tree;
 }
 
-std::vector<std::string> BooleanSearch::intersect(
-    const std::vector<std::string>& a,
-    const std::vector<std::string>& b) {
+std::vector<SearchResult> BooleanSearch::cachedSearch(const std::string& query, bool ranked,
+                                                      size_t offset, size_t limit) {
+    IndexSnapshot current = snapshot();
+    auto tree = parseQuery(query, current);
+    if (!query_error.empty()) return {};
     
-    std::vector<std::string> result;
-    size_t i = 0, j = 0;
+    std::string key = ranked ? "R " : "B ";
+    key += std::to_string(offset) + ' ' + std::to_string(limit) + ' ';
+    key += planner.canonicalKey(tree.get());
     
-    while (i < a.size() && j < b.size()) {
-        if (a[i] == b[j]) {
-            result.push_back(a[i]);
-            ++i; ++j;
-        } else if (a[i] < b[j]) {
-            ++i;
-        } else {
-            ++j;
-        }
+    std::vector<SearchResult> results;
+    cache.validate(current.generation);
+    if (cache.get(key, results)) return results;
+    
+    results = ranked ? rankedResults(tree.get(), current, offset, limit)
+                     : booleanResults(tree.get(), current, offset, limit);
+    
+    size_t bytes = CACHE_ENTRY_OVERHEAD + key.size() + results.capacity() * sizeof(SearchResult);
+    for (const auto& result : results) {
+        bytes += result.url.capacity() + result.source.capacity();
     }
+    cache.put(std::move(key), results, bytes);
+    return results;
+}
+
+std::vector<SearchResult> BooleanSearch::search(const std::string& query,
+                                                size_t offset, size_t limit) {
+    return cachedSearch(query, false, offset, limit);
+}
+
+std::vector<SearchResult> BooleanSearch::searchWithRanking(const std::string& query,
+                                                           size_t offset, size_t limit) {
+    return cachedSearch(query, true, offset, limit);
+}
+
+size_t BooleanSearch::estimateMatches(const std::string& query) {
+    IndexSnapshot current = snapshot();
+    auto tree = parseQuery(query, current);
+    if (!query_error.empty()) return 0;
     
-    return result;
+    size_t estimate = 0;
+    for (const auto& segment : current.segments) {
+        estimate += planner.plan(tree.get(), *segment.index)->cost;
+    }
+    return std::min(estimate, current.total_docs);
 }
 
-std::vector<std::string> BooleanSearch::unionSets(
-    const std::vector<std::string>& a,
-    const std::vector<std::string>& b) {
+std::unique_ptr<DocIterator> BooleanSearch::executeQuery(const PlanNode& plan,
+                                                         const SegmentView& segment) {
+    auto matches = buildIterator(plan, static_cast<uint32_t>(segment.index->getTotalDocuments()));
+    if (!segment.deleted) return matches;
+    return std::make_unique<LiveIterator>(std::move(matches), segment.deleted);
+}
+
+void BooleanSearch::resolveDocuments(const IndexSnapshot& snapshot,
+                                std::vector<SearchResult>& results) {
+    for (auto& result : results) {
+        const SegmentView& segment = snapshot.segments[snapshot.segmentOf(result.doc_id)];
+        result.url = segment.index->getUrl(result.doc_id - segment.base);
+        result.source = segment.index->getSource(result.doc_id - segment.base);
+    }
+}
+
+std::vector<SearchResult> BooleanSearch::booleanResults(const QueryNode* query,
+                                                        const IndexSnapshot& snapshot,
+                                                        size_t offset, size_t limit) {
+    std::vector<SearchResult> results;
+    size_t skipped = 0;
     
-    std::vector<std::string> result;
-    size_t i = 0, j = 0;
+    // Segments are in doc ID order, and so are the matches within each, so
+    // the page ends the evaluation.
+    for (const auto& segment : snapshot.segments) {
+        if (results.size() >= limit) break;
     
-    while (i < a.size() && j < b.size()) {
-        if (a[i] == b[j]) {
-            result.push_back(a[i]);
-            ++i; ++j;
-        } else if (a[i] < b[j]) {
-            result.push_back(a[i]);
-            ++i;
-        } else {
-            result.push_back(b[j]);
-            ++j;
+        auto plan = planner.plan(query, *segment.index);
+        auto matches = executeQuery(*plan, segment);
+        uint32_t doc = matches->docId();
+        for (; skipped < offset && doc != DocIterator::END; ++skipped) {
+            doc = matches->next();
         }
-    }
     
-    while (i < a.size()) result.push_back(a[i++]);
-    while (j < b.size()) result.push_back(b[j++]);
+        while (doc != DocIterator::END && results.size() < limit) {
+            SearchResult result;
+            result.doc_id = segment.base + doc;
+            result.relevance_score = 1;
+            results.push_back(result);
+            doc = matches->next();
+        }
+    }
     
-    return result;
+    resolveDocuments(snapshot, results);
+    return results;
+}
+
+bool BooleanSearch::isDisjunctive(const PlanNode& plan) {
+    if (plan.type == PlanType::TERM) return true;
+    if (plan.type != PlanType::OR) return false;
+    for (const auto& child : plan.children) {
+        if (child->type != PlanType::TERM) return false;
+    }
+    return true;
+}
+
+void BooleanSearch::countDocFreqs(const PlanNode& node,
+                                  std::unordered_map<std::string, uint32_t>& freqs) {
+    if (node.type == PlanType::TERM) {
+        freqs[node.terms[0]] += static_cast<uint32_t>(node.postings.size());
+    } else if (node.type == PlanType::POSITIONAL) {
+        for (size_t i = 0; i < node.group.size(); ++i) {
+            freqs[node.terms[i]] += static_cast<uint32_t>(node.group[i].size());
+        }
+    }
+    for (const auto& child : node.children) {
+        countDocFreqs(*child, freqs);
+    }
 }
 
-std::vector<std::string> BooleanSearch::difference(
-    const std::vector<std::string>& a,
-    const std::vector<std::string>& b) {
+void BooleanSearch::collectRankedTerms(const PlanNode& node, const SegmentView& segment,
+                                       const Bm25& bm25,
+                                       const std::unordered_map<std::string, uint32_t>& doc_freqs,
+                                       std::vector<RankedTerm>& terms) {
+    const DocumentTable& documents = segment.index->getDocuments();
     
-    std::vector<std::string> result;
-    size_t i = 0, j = 0;
+    auto add = [&](PostingView postings, const std::string& term) {
+        auto freq = doc_freqs.find(term);
+        uint32_t doc_freq = freq != doc_freqs.end() ? freq->second
+                                                    : static_cast<uint32_t>(postings.size());
+        double idf = bm25.idf(doc_freq);
     
-    while (i < a.size()) {
-        if (j >= b.size() || a[i] < b[j]) {
-            result.push_back(a[i]);
-            ++i;
-        } else if (a[i] == b[j]) {
-            ++i; ++j;
+        // Bounds are per segment: stored ones were computed with the
+        // segment's own statistics. BM25 is linear in idf and grows with
+        // the average length, so rescaling keeps them upper bounds.
+        double scale = 1.0;
+        if (postings.max_score <= 0.0f) {
+            std::vector<double> block_max;
+            postings.max_score = bm25.maxScore(postings, documents, block_max);
+            scale = idf / bm25.idf(static_cast<uint32_t>(postings.size()));
         } else {
-            ++j;
+            Bm25 local(documents.size(), documents.averageLength());
+            scale = idf / local.idf(static_cast<uint32_t>(postings.size()));
+            double global_average = bm25.averageLength();
+            if (global_average > documents.averageLength()) {
+                scale *= global_average / documents.averageLength();
+            }
         }
-    }
+        if (scale != 1.0) {
+            postings.max_score = std::nextafter(static_cast<float>(postings.max_score * scale),
+                                                HUGE_VALF);
+        }
+        terms.push_back({PostingIterator(postings), idf, postings.max_score});
+    };
     
-    return result;
+    switch (node.type) {
+        case PlanType::TERM:
+            add(node.postings, node.terms[0]);
+            break;
+        case PlanType::POSITIONAL:
+            for (size_t i = 0; i < node.group.size(); ++i) {
+                add(node.group[i], node.terms[i]);
+            }
+            break;
+        case PlanType::AND:
+        case PlanType::OR:
+            // Excluded operands and NOT subtrees do not contribute.
+            for (const auto& child : node.children) {
+                collectRankedTerms(*child, segment, bm25, doc_freqs, terms);
+            }
+            break;
+        case PlanType::EMPTY:
+        case PlanType::NOT:
+            break;
+    }
 }
 
-std::vector<std::string> BooleanSearch::executeQuery(
-    const std::vector<QueryToken>& tokens) {
+void BooleanSearch::rankDisjunctive(std::vector<RankedTerm>& terms, const SegmentView& segment,
+                                    const Bm25& bm25, TopKHeap& heap) {
+    const DocumentTable& documents = segment.index->getDocuments();
     
-    if (tokens.empty()) return {};
+    std::vector<RankedTerm*> order;
+    for (auto& term : terms) {
+        order.push_back(&term);
+    }
+    auto byDoc = [](const RankedTerm* a, const RankedTerm* b) {
+        return a->postings.docId() < b->postings.docId();
+    };
     
-    std::vector<std::string> result;
+    while (true) {
+        std::sort(order.begin(), order.end(), byDoc);
     
-    for (const auto& token : tokens) {
-        std::string stemmed = stemmer->stem(token.term);
-        
-        PostingList* posting = index->getPostingList(stemmed);
-        if (!posting) continue;
-        
-        std::vector<std::string> current_docs = posting->doc_ids;
-        std::sort(current_docs.begin(), current_docs.end());
-        
-        if (result.empty()) {
-            if (token.op != Operator::NOT) {
-                result = current_docs;
+        // WAND pivot: the first cursor at which the summed term upper bounds
+        // could beat the heap. No document before the pivot's can.
+        double bound = 0.0;
+        size_t pivot = order.size();
+        for (size_t i = 0; i < order.size() && !order[i]->postings.atEnd(); ++i) {
+            bound += order[i]->max_score;
+            if (!heap.full() || bound > heap.threshold()) {
+                pivot = i;
+                break;
             }
-        } else {
-            switch (token.op) {
-                case Operator::AND:
-                    result = intersect(result, current_docs);
-                    break;
-                case Operator::OR:
-                    result = unionSets(result, current_docs);
-                    break;
-                case Operator::NOT:
-                    result = difference(result, current_docs);
-                    break;
-                case Operator::NONE:
-                    result = intersect(result, current_docs);
-                    break;
+        }
+        if (pivot == order.size()) break;
+    
+        uint32_t pivot_doc = order[pivot]->postings.docId();
+        size_t last = pivot;
+        while (last + 1 < order.size() && order[last + 1]->postings.docId() == pivot_doc) {
+            ++last;
+        }
+    
+        // Block-max check: if the blocks around the pivot cannot beat the
+        // heap either, skip to the end of the shortest of those blocks.
+        if (heap.full()) {
+            uint32_t next_doc = last + 1 < order.size() ? order[last + 1]->postings.docId()
+                                                        : PostingIterator::END;
+            double block_bound = 0.0;
+            for (size_t i = 0; i <= last; ++i) {
+                uint32_t block_last;
+                block_bound += order[i]->postings.blockMaxScore(pivot_doc, block_last);
+                if (block_last != PostingIterator::END) {
+                    next_doc = std::min(next_doc, block_last + 1);
+                }
+            }
+            if (block_bound <= heap.threshold()) {
+                for (size_t i = 0; i <= last; ++i) {
+                    order[i]->postings.nextGEQ(next_doc);
+                }
+                continue;
             }
         }
-    }
     
-    return result;
+        if (order[0]->postings.docId() != pivot_doc) {
+            for (size_t i = 0; i < pivot; ++i) {
+                order[i]->postings.nextGEQ(pivot_doc);
+            }
+            continue;
+        }
+    
+        bool live = !segment.deleted || !segment.deleted->test(pivot_doc);
+        uint32_t length = documents.getLength(pivot_doc);
+        double score = 0.0;
+        for (size_t i = 0; i <= last; ++i) {
+            if (live) score += bm25.score(order[i]->postings.freq(), length, order[i]->idf);
+            order[i]->postings.next();
+        }
+        if (live) heap.push(segment.base + pivot_doc, score);
+    }
 }
 
-std::vector<SearchResult> BooleanSearch::search(const std::string& query) {
-    auto query_tokens = parseQuery(query);
-    auto doc_ids = executeQuery(query_tokens);
+void BooleanSearch::rankCandidates(DocIterator& matches, std::vector<RankedTerm>& terms,
+                                   const SegmentView& segment, const Bm25& bm25,
+                                   TopKHeap& heap) {
+    const DocumentTable& documents = segment.index->getDocuments();
     
-    std::vector<SearchResult> results;
-    for (const auto& doc_id : doc_ids) {
-        SearchResult result;
-        result.url = doc_id;
-        result.relevance_score = 1;
-        results.push_back(result);
+    for (uint32_t doc_id = matches.docId(); doc_id != DocIterator::END; doc_id = matches.next()) {
+        uint32_t length = documents.getLength(doc_id);
+        double score = 0.0;
+        for (auto& term : terms) {
+            if (term.postings.nextGEQ(doc_id) == doc_id) {
+                score += bm25.score(term.postings.freq(), length, term.idf);
+            }
+        }
+        heap.push(segment.base + doc_id, score);
     }
-    
-    return results;
 }
 
-std::vector<SearchResult> BooleanSearch::searchWithRanking(const std::string& query) {
-    auto query_tokens = parseQuery(query);
-    auto doc_ids = executeQuery(query_tokens);
+std::vector<SearchResult> BooleanSearch::rankedResults(const QueryNode* query,
+                                                       const IndexSnapshot& snapshot,
+                                                       size_t offset, size_t limit) {
+    // Collection statistics of all segments, deleted documents included
+    // until a merge drops them.
+    size_t num_docs = 0;
+    uint64_t total_length = 0;
+    std::vector<std::unique_ptr<PlanNode>> plans;
+    for (const auto& segment : snapshot.segments) {
+        num_docs += segment.index->getDocuments().size();
+        total_length += segment.index->getDocuments().totalLength();
+        plans.push_back(planner.plan(query, *segment.index));
+    }
+    Bm25 bm25(num_docs, num_docs ? static_cast<double>(total_length) / num_docs : 0.0);
     
-    std::vector<SearchResult> results;
+    std::unordered_map<std::string, uint32_t> doc_freqs;
+    if (plans.size() > 1) {
+        for (const auto& plan : plans) {
+            countDocFreqs(*plan, doc_freqs);
+        }
+    }
     
-    for (const auto& doc_id : doc_ids) {
-        SearchResult result;
-        result.url = doc_id;
-        result.relevance_score = 0;
-        
-        for (const auto& token : query_tokens) {
-            std::string stemmed = stemmer->stem(token.term);
-            PostingList* posting = index->getPostingList(stemmed);
-            
-            if (posting) {
-                for (size_t i = 0; i < posting->doc_ids.size(); ++i) {
-                    if (posting->doc_ids[i] == doc_id) {
-                        result.relevance_score += posting->frequencies[i];
-                        break;
-                    }
-                }
-            }
+    size_t k = limit > NO_LIMIT - offset ? NO_LIMIT : offset + limit;
+    k = std::min(k, num_docs);
+    if (k == 0) return {};
+    
+    TopKHeap heap(k);
+    for (size_t i = 0; i < plans.size(); ++i) {
+        const SegmentView& segment = snapshot.segments[i];
+        std::vector<RankedTerm> terms;
+        collectRankedTerms(*plans[i], segment, bm25, doc_freqs, terms);
+    
+        if (isDisjunctive(*plans[i])) {
+            rankDisjunctive(terms, segment, bm25, heap);
+        } else {
+            auto matches = executeQuery(*plans[i], segment);
+            rankCandidates(*matches, terms, segment, bm25, heap);
         }
-        
-        results.push_back(result);
     }
+    std::vector<ScoredDoc> top = heap.take();
     
-    std::sort(results.begin(), results.end(),
-              [](const SearchResult& a, const SearchResult& b) {
-                  return a.relevance_score > b.relevance_score;
-              });
+    std::vector<SearchResult> results;
+    for (size_t i = offset; i < top.size(); ++i) {
+        SearchResult result;
+        result.doc_id = top[i].doc_id;
+        result.relevance_score = top[i].score;
+        results.push_back(result);
+    }
     
+    resolveDocuments(snapshot, results);
     return results;
 }
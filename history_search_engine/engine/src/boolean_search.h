@@ -1,46 +1,111 @@
 #ifndef BOOLEAN_SEARCH_H
 #define BOOLEAN_SEARCH_H
 
+#include <cstdint>
+#include <limits>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "inverted_index.h"
-#include "stemmer.h"
-
-enum class Operator {
-    NONE,
-    AND,
-    OR,
-    NOT
-};
-
-struct QueryToken {
-    std::string term;
-    Operator op;
-};
+#include "lru_cache.h"
+#include "posting_iterator.h"
+#include "query_iterator.h"
+#include "query_parser.h"
+#include "query_planner.h"
+#include "ranking.h"
+#include "segmented_index.h"
+#include "stem_cache.h"
 
 struct SearchResult {
+    uint32_t doc_id;
     std::string url;
-    int relevance_score;
+    std::string source;
+    double relevance_score;
 };
 
 class BooleanSearch {
 private:
+    struct RankedTerm {
+        PostingIterator postings;
+        double idf;
+        double max_score;
+    };
+    
+    // Exactly one of the two is set.
     InvertedIndex* index;
-    Stemmer* stemmer;
+    SegmentedIndex* segments;
+    StemCache stems;
+    QueryParser parser;
+    QueryPlanner planner;
+    // Result pages keyed by mode, page and canonical query.
+    LruCache<std::vector<SearchResult>> cache;
+    // Why the last query was rejected, and what it could not honour.
+    std::string query_error;
+    std::string query_warning;
     
-    std::vector<QueryToken> parseQuery(const std::string& query);
-    std::vector<std::string> intersect(const std::vector<std::string>& a, 
-                                       const std::vector<std::string>& b);
-    std::vector<std::string> unionSets(const std::vector<std::string>& a,
-                                       const std::vector<std::string>& b);
-    std::vector<std::string> difference(const std::vector<std::string>& a,
-                                        const std::vector<std::string>& b);
-    std::vector<std::string> executeQuery(const std::vector<QueryToken>& tokens);
+    IndexSnapshot snapshot() const;
+    // Parses query and sets query_error and query_warning for it.
+    std::unique_ptr<QueryNode> parseQuery(const std::string& query, const IndexSnapshot& snapshot);
+    static bool usesPositions(const QueryNode* node);
+    std::vector<SearchResult> cachedSearch(const std::string& query, bool ranked,
+                                           size_t offset, size_t limit);
+    std::vector<SearchResult> booleanResults(const QueryNode* query, const IndexSnapshot& snapshot,
+                                             size_t offset, size_t limit);
+    std::vector<SearchResult> rankedResults(const QueryNode* query, const IndexSnapshot& snapshot,
+                                            size_t offset, size_t limit);
+    static std::unique_ptr<DocIterator> executeQuery(const PlanNode& plan,
+                                                     const SegmentView& segment);
+    static void resolveDocuments(const IndexSnapshot& snapshot, std::vector<SearchResult>& results);
+    
+    static bool isDisjunctive(const PlanNode& plan);
+    static void countDocFreqs(const PlanNode& node, std::unordered_map<std::string, uint32_t>& freqs);
+    static void collectRankedTerms(const PlanNode& node, const SegmentView& segment,
+                                   const Bm25& bm25,
+                                   const std::unordered_map<std::string, uint32_t>& doc_freqs,
+                                   std::vector<RankedTerm>& terms);
+    static void rankDisjunctive(std::vector<RankedTerm>& terms, const SegmentView& segment,
+                                const Bm25& bm25, TopKHeap& heap);
+    static void rankCandidates(DocIterator& matches, std::vector<RankedTerm>& terms,
+                               const SegmentView& segment, const Bm25& bm25, TopKHeap& heap);
     
 public:
-    BooleanSearch(InvertedIndex* idx, Stemmer* stem);
-    std::vector<SearchResult> search(const std::string& query);
-    std::vector<SearchResult> searchWithRanking(const std::string& query);
+    static const size_t NO_LIMIT = std::numeric_limits<size_t>::max();
+    static const size_t DEFAULT_CACHE_BYTES = 32 * 1024 * 1024;
+    // Rough cost of a cache entry beyond its key and results.
+    static const size_t CACHE_ENTRY_OVERHEAD = 128;
+    
+    // Repeated queries are answered from a result cache of cache_bytes
+    // (0 disables it), which is dropped whenever the index changes.
+    explicit BooleanSearch(InvertedIndex* idx, size_t cache_bytes = DEFAULT_CACHE_BYTES);
+    // Searches the live documents of all segments. Each query works on one
+    // snapshot, and BM25 uses the statistics of all segments together, so
+    // scores do not depend on how the documents are split into segments.
+    explicit BooleanSearch(SegmentedIndex* idx, size_t cache_bytes = DEFAULT_CACHE_BYTES);
+    // Queries support AND, OR, NOT (binding tightest), parentheses,
+    // "quoted phrases" and a NEAR/k b; juxtaposed operands mean AND.
+    // Without positions in the index, phrases and NEAR groups only require
+    // their terms to occur, and getQueryWarning() says so.
+    std::vector<SearchResult> search(const std::string& query,
+                                     size_t offset = 0, size_t limit = NO_LIMIT);
+    // BM25-ranked results. Queries made only of terms joined by OR run
+    // document-at-a-time with block-max WAND pruning; other queries rank the
+    // boolean matches. Only the best offset + limit documents are kept.
+    std::vector<SearchResult> searchWithRanking(const std::string& query,
+                                                size_t offset = 0, size_t limit = NO_LIMIT);
+    // Upper estimate of the number of documents matching query, taken from
+    // the planned posting list sizes without evaluating the query, so that
+    // paging does not undo the pruning of ranked search.
+    size_t estimateMatches(const std::string& query);
+    
+    // Why the last query was rejected, or empty if it was not. A rejected
+    // query has no results.
+    const std::string& getQueryError() const { return query_error; }
+    // Set when the last query was answered less precisely than asked.
+    const std::string& getQueryWarning() const { return query_warning; }
+    
+    CacheStats getCacheStats() const { return cache.stats(); }
+    void clearCache() { cache.clear(); }
 };
 
 #endif
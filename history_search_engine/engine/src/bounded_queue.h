@@ -0,0 +1,98 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+struct QueueStats {
+    uint64_t pushes = 0;
+    // Sum of the depth seen by every push, for the average depth.
+    uint64_t depth_sum = 0;
+    size_t max_depth = 0;
+    // Time producers waited for space and consumers waited for items.
+    uint64_t full_wait_ns = 0;
+    uint64_t empty_wait_ns = 0;
+};
+
+// Multi-producer, multi-consumer FIFO holding at most `capacity` items.
+// push() blocks while the queue is full, which throttles producers to the
+// pace of consumers. Items are whole batches, so one lock per push or pop
+// costs little next to the work each item carries.
+template<typename T>
+class BoundedQueue {
+private:
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+    QueueStats counters;
+    mutable std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+
+    static uint64_t elapsedNs(std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - since).count();
+    }
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity ? capacity : 1), closed(false) {}
+
+    // Returns false, dropping the item, if the queue has been closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (items.size() >= capacity && !closed) {
+            auto start = std::chrono::steady_clock::now();
+            not_full.wait(lock, [this] { return items.size() < capacity || closed; });
+            counters.full_wait_ns += elapsedNs(start);
+        }
+        if (closed) return false;
+
+        items.push_back(std::move(item));
+        counters.pushes++;
+        counters.depth_sum += items.size();
+        if (items.size() > counters.max_depth) counters.max_depth = items.size();
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Blocks until an item is available; returns false once the queue is
+    // closed and drained.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (items.empty() && !closed) {
+            auto start = std::chrono::steady_clock::now();
+            not_empty.wait(lock, [this] { return !items.empty() || closed; });
+            counters.empty_wait_ns += elapsedNs(start);
+        }
+        if (items.empty()) return false;
+
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return true;
+    }
+
+    // No more pushes: consumers drain what is left, then pop() fails.
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+    QueueStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+};
+
+#endif
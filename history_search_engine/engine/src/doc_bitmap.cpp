@@ -0,0 +1,142 @@
+#include "doc_bitmap.h"
+#include <algorithm>
+#include "posting_iterator.h"
+
+DocBitmap::DocBitmap(uint32_t num_bits) : words(wordCount(num_bits), 0), num_bits(num_bits) {}
+
+void DocBitmap::reset(uint32_t num_bits) {
+    this->num_bits = num_bits;
+    words.assign(wordCount(num_bits), 0);
+}
+
+// Calls fn(doc_ids, n) for every decoded block of postings.
+template<typename Fn>
+void DocBitmap::forEachBlock(const PostingView& postings, Fn fn) {
+    PostingIterator it(postings);
+    while (!it.atEnd()) {
+        fn(it.blockDocIds(), it.blockRemaining());
+        it.nextGEQ(it.blockLastDoc() + 1);
+    }
+}
+
+void DocBitmap::assign(const PostingView& postings) {
+    std::fill(words.begin(), words.end(), 0);
+    unite(postings);
+}
+
+void DocBitmap::unite(const PostingView& postings) {
+    if (postings.hasBitmap()) {
+        size_t n = std::min(words.size(), size_t(postings.bitmap_words));
+        for (size_t i = 0; i < n; ++i) {
+            words[i] |= postings.bitmap[i];
+        }
+        return;
+    }
+
+    forEachBlock(postings, [this](const uint32_t* docs, size_t n) {
+        for (size_t i = 0; i < n && docs[i] < num_bits; ++i) {
+            words[docs[i] / 64] |= uint64_t(1) << (docs[i] % 64);
+        }
+    });
+}
+
+void DocBitmap::intersect(const PostingView& postings) {
+    if (postings.hasBitmap()) {
+        size_t n = std::min(words.size(), size_t(postings.bitmap_words));
+        for (size_t i = 0; i < n; ++i) {
+            words[i] &= postings.bitmap[i];
+        }
+        std::fill(words.begin() + n, words.end(), 0);
+        return;
+    }
+
+    std::vector<uint64_t> kept(words.size(), 0);
+    forEachBlock(postings, [this, &kept](const uint32_t* docs, size_t n) {
+        for (size_t i = 0; i < n && docs[i] < num_bits; ++i) {
+            kept[docs[i] / 64] |= words[docs[i] / 64] & (uint64_t(1) << (docs[i] % 64));
+        }
+    });
+    words.swap(kept);
+}
+
+void DocBitmap::subtract(const PostingView& postings) {
+    if (postings.hasBitmap()) {
+        size_t n = std::min(words.size(), size_t(postings.bitmap_words));
+        for (size_t i = 0; i < n; ++i) {
+            words[i] &= ~postings.bitmap[i];
+        }
+        return;
+    }
+
+    forEachBlock(postings, [this](const uint32_t* docs, size_t n) {
+        for (size_t i = 0; i < n && docs[i] < num_bits; ++i) {
+            words[docs[i] / 64] &= ~(uint64_t(1) << (docs[i] % 64));
+        }
+    });
+}
+
+void DocBitmap::unite(const DocBitmap& other) {
+    size_t n = std::min(words.size(), other.words.size());
+    for (size_t i = 0; i < n; ++i) {
+        words[i] |= other.words[i];
+    }
+}
+
+void DocBitmap::intersect(const DocBitmap& other) {
+    size_t n = std::min(words.size(), other.words.size());
+    for (size_t i = 0; i < n; ++i) {
+        words[i] &= other.words[i];
+    }
+    std::fill(words.begin() + n, words.end(), 0);
+}
+
+void DocBitmap::subtract(const DocBitmap& other) {
+    size_t n = std::min(words.size(), other.words.size());
+    for (size_t i = 0; i < n; ++i) {
+        words[i] &= ~other.words[i];
+    }
+}
+
+void DocBitmap::flip() {
+    for (auto& word : words) {
+        word = ~word;
+    }
+    if (num_bits % 64) {
+        words.back() &= (uint64_t(1) << (num_bits % 64)) - 1;
+    }
+}
+
+size_t DocBitmap::count() const {
+    size_t total = 0;
+    for (uint64_t word : words) {
+        total += __builtin_popcountll(word);
+    }
+    return total;
+}
+
+uint32_t DocBitmap::nextSet(uint32_t from) const {
+    if (from >= num_bits) return END;
+
+    size_t i = from / 64;
+    uint64_t word = words[i] & (~uint64_t(0) << (from % 64));
+    while (word == 0) {
+        if (++i == words.size()) return END;
+        word = words[i];
+    }
+    return static_cast<uint32_t>(i * 64 + __builtin_ctzll(word));
+}
+
+void DocBitmap::save(std::ostream& out) const {
+    out.write(reinterpret_cast<const char*>(&num_bits), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint64_t));
+}
+
+bool DocBitmap::load(std::istream& in) {
+    uint32_t bits = 0;
+    in.read(reinterpret_cast<char*>(&bits), sizeof(uint32_t));
+    if (!in) return false;
+
+    reset(bits);
+    in.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(uint64_t));
+    return static_cast<bool>(in);
+}
@@ -0,0 +1,62 @@
+#ifndef DOC_BITMAP_H
+#define DOC_BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "posting_list.h"
+
+// Set of doc IDs in [0, size) as a plain bit vector, combined 64 documents
+// at a time. Terms at least as dense as 1 / DENSE_RATIO of the collection
+// (the Roaring array/bitmap cut-off) carry such a bitmap in the index file;
+// for the others the operations decode the postings instead.
+class DocBitmap {
+private:
+    std::vector<uint64_t> words;
+    uint32_t num_bits;
+
+    template<typename Fn>
+    static void forEachBlock(const PostingView& postings, Fn fn);
+
+public:
+    static const uint32_t DENSE_RATIO = 16;
+    static const uint32_t END = 0xFFFFFFFFu;
+
+    static bool isDense(size_t count, size_t num_docs) {
+        return num_docs > 0 && count * DENSE_RATIO >= num_docs;
+    }
+    static size_t wordCount(uint32_t num_bits) { return (num_bits + 63) / 64; }
+
+    explicit DocBitmap(uint32_t num_bits = 0);
+
+    void reset(uint32_t num_bits);
+    void assign(const PostingView& postings);
+    void unite(const PostingView& postings);
+    void intersect(const PostingView& postings);
+    void subtract(const PostingView& postings);
+    void unite(const DocBitmap& other);
+    void intersect(const DocBitmap& other);
+    void subtract(const DocBitmap& other);
+    // Complement within [0, size).
+    void flip();
+
+    void set(uint32_t doc) {
+        if (doc < num_bits) words[doc / 64] |= uint64_t(1) << (doc % 64);
+    }
+    bool test(uint32_t doc) const {
+        return doc < num_bits && (words[doc / 64] >> (doc % 64)) & 1;
+    }
+    size_t count() const;
+    // First set bit >= from, or END.
+    uint32_t nextSet(uint32_t from) const;
+
+    uint32_t size() const { return num_bits; }
+    const uint64_t* data() const { return words.data(); }
+    size_t numWords() const { return words.size(); }
+
+    void save(std::ostream& out) const;
+    bool load(std::istream& in);
+};
+
+#endif
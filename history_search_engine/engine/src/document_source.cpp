@@ -0,0 +1,32 @@
+#include "document_source.h"
+#include "json_reader.h"
+
+void RawBatch::addDocument(std::string_view url, std::string_view html_content,
+                           std::string_view source) {
+    documents.push_back({static_cast<uint32_t>(url.size()),
+                         static_cast<uint32_t>(html_content.size()),
+                         static_cast<uint32_t>(source.size())});
+    text += url;
+    text += html_content;
+    text += source;
+}
+
+size_t RawBatch::forEachDocument(const std::function<void(const DocumentView&)>& callback) const {
+    size_t count = lines.empty() ? 0 : JSONReader::forEachInRange(lines, callback);
+
+    size_t pos = 0;
+    for (const auto& document : documents) {
+        DocumentView doc;
+        doc.url = std::string_view(text.data() + pos, document.url_length);
+        pos += document.url_length;
+        doc.html_content = std::string_view(text.data() + pos, document.html_length);
+        pos += document.html_length;
+        doc.source = std::string_view(text.data() + pos, document.source_length);
+        pos += document.source_length;
+
+        if (doc.url.empty() || doc.html_content.empty()) continue;
+        callback(doc);
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,59 @@
+#ifndef DOCUMENT_SOURCE_H
+#define DOCUMENT_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Fields of one record. They point into the mapped file, or into the
+// reader's buffers when the JSON string had escapes, and are valid only
+// until the next record is parsed.
+struct DocumentView {
+    std::string_view url;
+    std::string_view html_content;
+    std::string_view source;
+};
+
+// Documents the read stage of an IngestPipeline hands to one worker:
+// either a range of whole JSON lines of a mapped file, which the worker
+// parses, or documents copied out of a database cursor, whose fields are
+// stored back to back in `text`.
+struct RawBatch {
+    struct Document {
+        uint32_t url_length;
+        uint32_t html_length;
+        uint32_t source_length;
+    };
+
+    uint64_t sequence = 0;
+    std::string_view lines;
+    std::string text;
+    std::vector<Document> documents;
+
+    void addDocument(std::string_view url, std::string_view html_content,
+                     std::string_view source);
+    size_t bytes() const { return lines.size() + text.size(); }
+    // Calls callback for every document with a url and HTML content and
+    // returns their number.
+    size_t forEachDocument(const std::function<void(const DocumentView&)>& callback) const;
+};
+
+// Input of an IngestPipeline. read() is only called from the pipeline's
+// read thread; it fills the next batch of about batch_bytes, in input
+// order, and returns false at the end of the input or on an error.
+class DocumentSource {
+public:
+    virtual ~DocumentSource() = default;
+
+    virtual bool read(RawBatch& batch, size_t batch_bytes) = 0;
+    // True if reading stopped on an error rather than at the end.
+    virtual bool failed() const { return false; }
+    // Called once everything read has been saved in the index, so that a
+    // source that can resume records where the next run starts.
+    virtual bool commit() { return true; }
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include "document_table.h"
+#include <algorithm>
+#include <cstring>
+
+DocumentTable::DocumentTable()
+    : count(0), total_length(0), mapped_urls(nullptr), mapped_offsets(nullptr),
+      mapped_sources(nullptr), mapped_lengths(nullptr) {}
+
+void DocumentTable::writeVarint(std::vector<char>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint32_t DocumentTable::readVarint(const char*& p) {
+    uint32_t value = 0;
+    int shift = 0;
+    while (true) {
+        unsigned char byte = static_cast<unsigned char>(*p++);
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) break;
+        shift += 7;
+    }
+    return value;
+}
+
+uint16_t DocumentTable::internSource(std::string_view source) {
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (sources[i] == source) {
+            return static_cast<uint16_t>(i);
+        }
+    }
+    sources.emplace_back(source);
+    return static_cast<uint16_t>(sources.size() - 1);
+}
+
+uint32_t DocumentTable::add(std::string_view url, std::string_view source, uint32_t length) {
+    uint32_t doc_id = count++;
+
+    size_t shared = 0;
+    if (doc_id % URLS_PER_BLOCK == 0) {
+        block_offsets.push_back(static_cast<uint32_t>(url_data.size()));
+    } else {
+        size_t max_shared = std::min(url.length(), last_url.length());
+        while (shared < max_shared && url[shared] == last_url[shared]) {
+            shared++;
+        }
+        writeVarint(url_data, static_cast<uint32_t>(shared));
+    }
+
+    writeVarint(url_data, static_cast<uint32_t>(url.length() - shared));
+    url_data.insert(url_data.end(), url.begin() + shared, url.end());
+
+    doc_sources.push_back(internSource(source));
+    doc_lengths.push_back(length);
+    total_length += length;
+    last_url = url;
+
+    return doc_id;
+}
+
+std::string DocumentTable::getUrl(uint32_t doc_id) const {
+    if (doc_id >= count) return "";
+
+    const char* p = urlData() + blockOffset(doc_id / URLS_PER_BLOCK);
+    std::string url;
+
+    uint32_t len = readVarint(p);
+    url.assign(p, len);
+    p += len;
+
+    for (uint32_t i = 0; i < doc_id % URLS_PER_BLOCK; ++i) {
+        uint32_t shared = readVarint(p);
+        uint32_t suffix = readVarint(p);
+        url.resize(shared);
+        url.append(p, suffix);
+        p += suffix;
+    }
+
+    return url;
+}
+
+const std::string& DocumentTable::getSource(uint32_t doc_id) const {
+    static const std::string empty;
+    if (doc_id >= count) return empty;
+    return sources[docSource(doc_id)];
+}
+
+void DocumentTable::clear() {
+    url_data.clear();
+    block_offsets.clear();
+    doc_sources.clear();
+    doc_lengths.clear();
+    sources.clear();
+    last_url.clear();
+    count = 0;
+    total_length = 0;
+    mapped_urls = nullptr;
+    mapped_offsets = nullptr;
+    mapped_sources = nullptr;
+    mapped_lengths = nullptr;
+}
+
+// Layout: count, number of URL blocks, URL data size and number of sources
+// (uint32 each) and the total length (uint64), then block offsets, document
+// lengths, per-document source ids, URL data and the sources as (uint32
+// length, bytes). The fixed-size arrays come first so they stay aligned
+// when the table is mapped.
+void DocumentTable::save(std::ostream& out) const {
+    uint32_t num_blocks = static_cast<uint32_t>(block_offsets.size());
+    uint32_t data_size = static_cast<uint32_t>(url_data.size());
+    uint32_t num_sources = static_cast<uint32_t>(sources.size());
+    
+    out.write(reinterpret_cast<const char*>(&count), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&num_blocks), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&data_size), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&num_sources), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&total_length), sizeof(uint64_t));
+    
+    out.write(reinterpret_cast<const char*>(block_offsets.data()),
+              num_blocks * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(doc_lengths.data()),
+              doc_lengths.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(doc_sources.data()),
+              doc_sources.size() * sizeof(uint16_t));
+    out.write(url_data.data(), data_size);
+    
+    for (const auto& source : sources) {
+        uint32_t len = static_cast<uint32_t>(source.length());
+        out.write(reinterpret_cast<const char*>(&len), sizeof(uint32_t));
+        out.write(source.c_str(), len);
+    }
+}
+
+bool DocumentTable::attach(const char* data, size_t size) {
+    clear();
+    
+    uint32_t fields[4];
+    uint64_t length_sum;
+    if (size < sizeof(fields) + sizeof(length_sum) ||
+        reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0) {
+        return false;
+    }
+    std::memcpy(fields, data, sizeof(fields));
+    std::memcpy(&length_sum, data + sizeof(fields), sizeof(length_sum));
+    uint32_t num_docs = fields[0];
+    uint32_t num_blocks = fields[1];
+    uint32_t data_size = fields[2];
+    uint32_t num_sources = fields[3];
+    
+    size_t pos = sizeof(fields) + sizeof(length_sum);
+    size_t arrays = size_t(num_blocks) * sizeof(uint32_t) + size_t(num_docs) * sizeof(uint32_t) +
+                    size_t(num_docs) * sizeof(uint16_t) + data_size;
+    if (num_blocks != (num_docs + URLS_PER_BLOCK - 1) / URLS_PER_BLOCK || size - pos < arrays) {
+        return false;
+    }
+    
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(data + pos);
+    pos += num_blocks * sizeof(uint32_t);
+    const uint32_t* lengths = reinterpret_cast<const uint32_t*>(data + pos);
+    pos += num_docs * sizeof(uint32_t);
+    const uint16_t* doc_source_ids = reinterpret_cast<const uint16_t*>(data + pos);
+    pos += num_docs * sizeof(uint16_t);
+    const char* urls = data + pos;
+    pos += data_size;
+    
+    for (uint32_t i = 0; i < num_sources; ++i) {
+        uint32_t len;
+        if (size - pos < sizeof(uint32_t)) return false;
+        std::memcpy(&len, data + pos, sizeof(uint32_t));
+        pos += sizeof(uint32_t);
+        if (size - pos < len) return false;
+        sources.emplace_back(data + pos, len);
+        pos += len;
+    }
+    
+    for (uint32_t b = 0; b < num_blocks; ++b) {
+        if (offsets[b] >= data_size) {
+            sources.clear();
+            return false;
+        }
+    }
+    for (uint32_t d = 0; d < num_docs; ++d) {
+        if (doc_source_ids[d] >= num_sources) {
+            sources.clear();
+            return false;
+        }
+    }
+    
+    count = num_docs;
+    total_length = length_sum;
+    mapped_lengths = lengths;
+    mapped_urls = urls;
+    mapped_offsets = offsets;
+    mapped_sources = doc_source_ids;
+    return true;
+}
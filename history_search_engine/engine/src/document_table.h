@@ -0,0 +1,81 @@
+#ifndef DOCUMENT_TABLE_H
+#define DOCUMENT_TABLE_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Maps dense document IDs to URLs, sources and lengths in tokens. URLs are front-coded in
+// blocks of URLS_PER_BLOCK: the first URL of a block is stored in full,
+// every following one as (shared prefix length, suffix). Sources are
+// interned, since a corpus only has a handful of them. A table attached to
+// a mapped index file reads its arrays in place and is read-only.
+class DocumentTable {
+private:
+    static const size_t URLS_PER_BLOCK = 16;
+
+    std::vector<char> url_data;
+    std::vector<uint32_t> block_offsets;
+    std::vector<uint16_t> doc_sources;
+    std::vector<uint32_t> doc_lengths;
+    std::vector<std::string> sources;
+    std::string last_url;
+    uint32_t count;
+    uint64_t total_length;
+    const char* mapped_urls;
+    const uint32_t* mapped_offsets;
+    const uint16_t* mapped_sources;
+    const uint32_t* mapped_lengths;
+
+    static void writeVarint(std::vector<char>& out, uint32_t value);
+    static uint32_t readVarint(const char*& p);
+    uint16_t internSource(std::string_view source);
+    const char* urlData() const { return mapped_urls ? mapped_urls : url_data.data(); }
+    uint32_t blockOffset(size_t block) const {
+        return mapped_offsets ? mapped_offsets[block] : block_offsets[block];
+    }
+    uint16_t docSource(uint32_t doc_id) const {
+        return mapped_sources ? mapped_sources[doc_id] : doc_sources[doc_id];
+    }
+
+public:
+    DocumentTable();
+    uint32_t add(std::string_view url, std::string_view source, uint32_t length = 0);
+    std::string getUrl(uint32_t doc_id) const;
+    // Calls fn(doc_id, url) for every document in order, which decodes
+    // each front-coded block once instead of once per URL.
+    template<typename Fn>
+    void forEachUrl(Fn fn) const {
+        std::string url;
+        const char* p = nullptr;
+        for (uint32_t doc_id = 0; doc_id < count; ++doc_id) {
+            uint32_t shared = 0;
+            if (doc_id % URLS_PER_BLOCK == 0) {
+                p = urlData() + blockOffset(doc_id / URLS_PER_BLOCK);
+            } else {
+                shared = readVarint(p);
+            }
+            uint32_t suffix = readVarint(p);
+            url.resize(shared);
+            url.append(p, suffix);
+            p += suffix;
+            fn(doc_id, std::string_view(url));
+        }
+    }
+    const std::string& getSource(uint32_t doc_id) const;
+    uint32_t getLength(uint32_t doc_id) const {
+        return mapped_lengths ? mapped_lengths[doc_id] : doc_lengths[doc_id];
+    }
+    uint64_t totalLength() const { return total_length; }
+    double averageLength() const { return count ? static_cast<double>(total_length) / count : 0.0; }
+    uint32_t size() const { return count; }
+    void clear();
+    void save(std::ostream& out) const;
+    // Points the table at data written by save(); the buffer must stay
+    // valid and 4-byte aligned.
+    bool attach(const char* data, size_t size);
+};
+
+#endif
@@ -1,143 +1,246 @@
 #ifndef HASH_TABLE_H
 #define HASH_TABLE_H
 
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <utility>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// 64-bit MurmurHash2 (MurmurHash64A) over the key bytes, 8 bytes at a time.
+inline uint64_t hashString(std::string_view key) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+
+    uint64_t h = 0x9747b28c ^ (key.size() * m);
+    const char* data = key.data();
+    const char* end = data + (key.size() & ~static_cast<size_t>(7));
+
+    for (; data != end; data += 8) {
+        uint64_t k;
+        std::memcpy(&k, data, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch (key.size() & 7) {
+        case 7: h ^= static_cast<uint64_t>(static_cast<unsigned char>(data[6])) << 48; [[fallthrough]];
+        case 6: h ^= static_cast<uint64_t>(static_cast<unsigned char>(data[5])) << 40; [[fallthrough]];
+        case 5: h ^= static_cast<uint64_t>(static_cast<unsigned char>(data[4])) << 32; [[fallthrough]];
+        case 4: h ^= static_cast<uint64_t>(static_cast<unsigned char>(data[3])) << 24; [[fallthrough]];
+        case 3: h ^= static_cast<uint64_t>(static_cast<unsigned char>(data[2])) << 16; [[fallthrough]];
+        case 2: h ^= static_cast<uint64_t>(static_cast<unsigned char>(data[1])) << 8; [[fallthrough]];
+        case 1: h ^= static_cast<uint64_t>(static_cast<unsigned char>(data[0]));
+                h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+// Open-addressing table in the style of Swiss tables. A control byte per
+// slot holds either EMPTY or the low 7 bits of the key's hash; probing scans
+// aligned groups of 16 control bytes at once (SSE2 when available) and only
+// compares keys whose stored full hash matches. The capacity is a power of
+// two and the table grows at 7/8 load.
 template<typename V>
 class HashTable {
 private:
-    struct Entry {
+    static constexpr size_t GROUP_WIDTH = 16;
+    static constexpr uint8_t EMPTY = 0x80;
+
+    struct Slot {
         std::string key;
         V value;
-        bool occupied;
-        bool deleted;
-        
-        Entry() : occupied(false), deleted(false) {}
     };
-    
-    std::vector<Entry> table;
+
+    std::vector<uint8_t> ctrl;
+    std::vector<uint64_t> hashes;
+    std::vector<Slot> slots;
     size_t capacity;
     size_t count;
-    
-    size_t hash1(const std::string& key) const {
-        size_t h = 0;
-        for (char c : key) {
-            h = h * 37 + static_cast<unsigned char>(c);
+
+    static uint8_t fragment(uint64_t hash) { return static_cast<uint8_t>(hash & 0x7F); }
+    size_t groupStart(uint64_t hash) const { return (hash >> 7) & (capacity - 1) & ~(GROUP_WIDTH - 1); }
+
+    uint32_t matchGroup(size_t group, uint8_t byte) const {
+#ifdef __SSE2__
+        __m128i ctrl_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&ctrl[group]));
+        __m128i target = _mm_set1_epi8(static_cast<char>(byte));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_bytes, target)));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+            if (ctrl[group + i] == byte) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Returns the slot holding key, or the first empty slot on its probe
+    // sequence, which is where the key would be inserted.
+    size_t findSlot(std::string_view key, uint64_t hash, bool& found) const {
+        uint8_t h2 = fragment(hash);
+        size_t group = groupStart(hash);
+
+        for (size_t step = GROUP_WIDTH; ; step += GROUP_WIDTH) {
+            uint32_t match = matchGroup(group, h2);
+            while (match) {
+                size_t idx = group + __builtin_ctz(match);
+                if (hashes[idx] == hash && slots[idx].key == key) {
+                    found = true;
+                    return idx;
+                }
+                match &= match - 1;
+            }
+
+            uint32_t empty = matchGroup(group, EMPTY);
+            if (empty) {
+                found = false;
+                return group + __builtin_ctz(empty);
+            }
+
+            group = (group + step) & (capacity - 1);
         }
-        return h % capacity;
     }
-    
-    size_t hash2(const std::string& key) const {
-        size_t h = 0;
-        for (char c : key) {
-            h = h * 53 + static_cast<unsigned char>(c);
+
+    size_t findEmpty(uint64_t hash) const {
+        size_t group = groupStart(hash);
+        for (size_t step = GROUP_WIDTH; ; step += GROUP_WIDTH) {
+            uint32_t empty = matchGroup(group, EMPTY);
+            if (empty) {
+                return group + __builtin_ctz(empty);
+            }
+            group = (group + step) & (capacity - 1);
         }
-        return (h % (capacity - 1)) + 1;
     }
-    
+
     void rehash() {
-        std::vector<Entry> old_table = table;
+        std::vector<uint8_t> old_ctrl;
+        std::vector<uint64_t> old_hashes;
+        std::vector<Slot> old_slots;
+        old_ctrl.swap(ctrl);
+        old_hashes.swap(hashes);
+        old_slots.swap(slots);
+
         capacity *= 2;
-        table.clear();
-        table.resize(capacity);
-        count = 0;
-        
-        for (const auto& entry : old_table) {
-            if (entry.occupied && !entry.deleted) {
-                insert(entry.key, entry.value);
-            }
+        ctrl.assign(capacity, EMPTY);
+        hashes.resize(capacity);
+        slots.resize(capacity);
+
+        for (size_t i = 0; i < old_ctrl.size(); ++i) {
+            if (old_ctrl[i] == EMPTY) continue;
+
+            size_t idx = findEmpty(old_hashes[i]);
+            ctrl[idx] = old_ctrl[i];
+            hashes[idx] = old_hashes[i];
+            slots[idx].key = std::move(old_slots[i].key);
+            slots[idx].value = std::move(old_slots[i].value);
         }
     }
-    
-public:
-    HashTable(size_t initial_capacity = 16384) 
-        : capacity(initial_capacity), count(0) {
-        table.resize(capacity);
-    }
-    
-    void insert(const std::string& key, const V& value) {
-        if (count * 2 >= capacity) {
-            rehash();
+
+    template<typename K, typename... Args>
+    std::pair<V*, bool> emplaceKey(K&& key, Args&&... args) {
+        uint64_t hash = hashString(key);
+        bool found;
+        size_t idx = findSlot(key, hash, found);
+        if (found) {
+            return {&slots[idx].value, false};
         }
-        
-        size_t h1 = hash1(key);
-        size_t h2 = hash2(key);
-        size_t i = 0;
-        
-        while (i < capacity) {
-            size_t idx = (h1 + i * h2) % capacity;
-            
-            if (!table[idx].occupied || table[idx].deleted) {
-                table[idx].key = key;
-                table[idx].value = value;
-                table[idx].occupied = true;
-                table[idx].deleted = false;
-                count++;
-                return;
-            }
-            
-            if (table[idx].key == key) {
-                table[idx].value = value;
-                return;
-            }
-            
-            i++;
+
+        if ((count + 1) * 8 > capacity * 7) {
+            rehash();
+            idx = findEmpty(hash);
         }
+
+        ctrl[idx] = fragment(hash);
+        hashes[idx] = hash;
+        slots[idx].key = std::string(std::forward<K>(key));
+        slots[idx].value = V(std::forward<Args>(args)...);
+        count++;
+        return {&slots[idx].value, true};
     }
-    
-    bool find(const std::string& key, V& value) const {
-        size_t h1 = hash1(key);
-        size_t h2 = hash2(key);
-        size_t i = 0;
-        
-        while (i < capacity) {
-            size_t idx = (h1 + i * h2) % capacity;
-            
-            if (!table[idx].occupied) {
-                return false;
-            }
-            
-            if (!table[idx].deleted && table[idx].key == key) {
-                value = table[idx].value;
-                return true;
-            }
-            
-            i++;
-        }
-        
-        return false;
-    }
-    
-    V* get(const std::string& key) {
-        size_t h1 = hash1(key);
-        size_t h2 = hash2(key);
-        size_t i = 0;
-        
-        while (i < capacity) {
-            size_t idx = (h1 + i * h2) % capacity;
-            
-            if (!table[idx].occupied) {
-                return nullptr;
-            }
-            
-            if (!table[idx].deleted && table[idx].key == key) {
-                return &table[idx].value;
-            }
-            
-            i++;
+
+public:
+    HashTable(size_t initial_capacity = 16384) : capacity(GROUP_WIDTH), count(0) {
+        while (capacity < initial_capacity) {
+            capacity *= 2;
         }
-        
-        return nullptr;
+        ctrl.assign(capacity, EMPTY);
+        hashes.resize(capacity);
+        slots.resize(capacity);
+    }
+
+    void insert(const std::string& key, const V& value) {
+        *try_emplace(std::string_view(key)).first = value;
+    }
+
+    void insert(std::string&& key, V&& value) {
+        *try_emplace(std::move(key)).first = std::move(value);
     }
-    
+
+    // Inserts V(args...) under key unless the key is already present. Returns
+    // a pointer to the stored value and whether an insertion took place. The
+    // pointer stays valid until the next insertion.
+    template<typename... Args>
+    std::pair<V*, bool> try_emplace(std::string_view key, Args&&... args) {
+        return emplaceKey(key, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    std::pair<V*, bool> try_emplace(std::string&& key, Args&&... args) {
+        return emplaceKey(std::move(key), std::forward<Args>(args)...);
+    }
+
+    // Calls update(value) in place, default-constructing the value first if
+    // the key is missing.
+    template<typename Update>
+    V& upsert(std::string_view key, Update update) {
+        V* value = try_emplace(key).first;
+        update(*value);
+        return *value;
+    }
+
+    V& operator[](std::string_view key) {
+        return *try_emplace(key).first;
+    }
+
+    bool find(std::string_view key, V& value) const {
+        const V* found = get(key);
+        if (!found) return false;
+        value = *found;
+        return true;
+    }
+
+    V* get(std::string_view key) {
+        bool found;
+        size_t idx = findSlot(key, hashString(key), found);
+        return found ? &slots[idx].value : nullptr;
+    }
+
+    const V* get(std::string_view key) const {
+        bool found;
+        size_t idx = findSlot(key, hashString(key), found);
+        return found ? &slots[idx].value : nullptr;
+    }
+
     size_t size() const { return count; }
-    
+
     template<typename Callback>
     void iterate(Callback callback) const {
-        for (const auto& entry : table) {
-            if (entry.occupied && !entry.deleted) {
-                callback(entry.key, entry.value);
+        for (size_t i = 0; i < capacity; ++i) {
+            if (ctrl[i] != EMPTY) {
+                callback(slots[i].key, slots[i].value);
             }
         }
     }
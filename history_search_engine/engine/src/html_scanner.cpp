@@ -0,0 +1,182 @@
+#include "html_scanner.h"
+#include <cstdint>
+#include <cstring>
+#include "utf8.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+struct NamedReference {
+    std::string_view name;
+    std::string_view text;
+};
+
+// Whitespace and punctuation all end a word, so only their class matters;
+// the soft hyphen decodes to nothing and leaves the word whole.
+constexpr NamedReference NAMED_REFERENCES[] = {
+    {"amp", "&"},
+    {"apos", "'"},
+    {"copy", "\xC2\xA9"},
+    {"gt", ">"},
+    {"hellip", "\xE2\x80\xA6"},
+    {"laquo", "\xC2\xAB"},
+    {"lt", "<"},
+    {"mdash", "\xE2\x80\x94"},
+    {"nbsp", " "},
+    {"ndash", "\xE2\x80\x93"},
+    {"quot", "\""},
+    {"raquo", "\xC2\xBB"},
+    {"shy", ""}
+};
+
+constexpr size_t MAX_REFERENCE_NAME = 6;
+
+char toLowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c;
+}
+
+bool isAsciiLetter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool startsWithNoCase(std::string_view text, size_t i, std::string_view prefix) {
+    if (text.size() - i < prefix.size()) return false;
+    for (size_t k = 0; k < prefix.size(); ++k) {
+        if (toLowerAscii(text[i + k]) != prefix[k]) return false;
+    }
+    return true;
+}
+
+size_t find(std::string_view text, size_t from, std::string_view needle) {
+    size_t pos = text.find(needle, from);
+    return pos == std::string_view::npos ? text.size() : pos;
+}
+
+// Index just past the next '>' at or after i, or the end of text.
+size_t pastTagEnd(std::string_view text, size_t i) {
+    size_t pos = find(text, i, ">");
+    return pos == text.size() ? pos : pos + 1;
+}
+
+// Raw text elements: their bodies are not markup and not visible text.
+// Returns the element name if a tag with that name starts at text[i].
+std::string_view rawTextElement(std::string_view text, size_t i) {
+    for (std::string_view name : {std::string_view("script"), std::string_view("style")}) {
+        if (!startsWithNoCase(text, i, name)) continue;
+        size_t end = i + name.size();
+        if (end == text.size() || !isAsciiLetter(text[end])) return name;
+    }
+    return {};
+}
+
+int digitValue(char c, bool hex) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (!hex) return -1;
+    c = toLowerAscii(c);
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+}
+
+size_t HtmlScanner::findMarkup(std::string_view html, size_t i) {
+    const char* text = html.data();
+    size_t n = html.size();
+#ifdef __SSE2__
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i amp = _mm_set1_epi8('&');
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(bytes, lt), _mm_cmpeq_epi8(bytes, amp));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+#endif
+    for (; i < n; ++i) {
+        if (text[i] == '<' || text[i] == '&') return i;
+    }
+    return n;
+}
+
+size_t HtmlScanner::skipMarkup(std::string_view html, size_t i) {
+    size_t n = html.size();
+    if (i + 1 == n) return n;
+
+    char next = html[i + 1];
+    if (next == '!') {
+        if (html.compare(i + 2, 2, "--") == 0) {
+            size_t end = find(html, i + 4, "-->");
+            return end == n ? n : end + 3;
+        }
+        return pastTagEnd(html, i + 2);
+    }
+    if (next == '/' || next == '?') {
+        return pastTagEnd(html, i + 2);
+    }
+    if (!isAsciiLetter(next)) {
+        return i + 1;
+    }
+
+    std::string_view raw = rawTextElement(html, i + 1);
+    size_t end = pastTagEnd(html, i + 1);
+    if (raw.empty() || end == n || html[end - 2] == '/') return end;
+
+    // Skip the element body up to its end tag.
+    for (size_t pos = end; (pos = find(html, pos, "</")) < n; pos += 2) {
+        if (startsWithNoCase(html, pos + 2, raw) &&
+            (pos + 2 + raw.size() == n || !isAsciiLetter(html[pos + 2 + raw.size()]))) {
+            return pastTagEnd(html, pos + 2 + raw.size());
+        }
+    }
+    return n;
+}
+
+size_t HtmlScanner::decodeReference(std::string_view html, size_t i, Decoded& decoded) {
+    size_t n = html.size();
+    decoded.bytes[0] = '&';
+    decoded.length = 1;
+
+    size_t pos = i + 1;
+    if (pos < n && html[pos] == '#') {
+        pos++;
+        bool hex = pos < n && (html[pos] == 'x' || html[pos] == 'X');
+        if (hex) pos++;
+
+        size_t digits_start = pos;
+        uint32_t code_point = 0;
+        int digit;
+        while (pos < n && (digit = digitValue(html[pos], hex)) >= 0) {
+            code_point = code_point * (hex ? 16 : 10) + digit;
+            if (code_point > MAX_CODE_POINT) return i + 1;
+            pos++;
+        }
+        if (pos == digits_start) return i + 1;
+        if (code_point == 0 || isSurrogate(code_point)) {
+            code_point = REPLACEMENT_CHARACTER;
+        }
+        if (pos < n && html[pos] == ';') pos++;
+
+        decoded.length = encodeUtf8(code_point, decoded.bytes);
+        return pos;
+    }
+
+    size_t name_end = pos;
+    while (name_end < n && name_end - pos <= MAX_REFERENCE_NAME && isAsciiLetter(html[name_end])) {
+        name_end++;
+    }
+    if (name_end == n || html[name_end] != ';') return i + 1;
+
+    std::string_view name = html.substr(pos, name_end - pos);
+    for (const auto& reference : NAMED_REFERENCES) {
+        if (reference.name == name) {
+            std::memcpy(decoded.bytes, reference.text.data(), reference.text.size());
+            decoded.length = reference.text.size();
+            return name_end + 1;
+        }
+    }
+    return i + 1;
+}
@@ -0,0 +1,59 @@
+#ifndef HTML_SCANNER_H
+#define HTML_SCANNER_H
+
+#include <cstddef>
+#include <string_view>
+#include "tokenizer.h"
+
+// Tokenizes the visible text of raw HTML in a single pass, without building
+// a cleaned copy of it. Plain text is handed to the tokenizer in runs
+// between markup bytes; tags, comments and the bodies of <script> and
+// <style> end the current word and are skipped; character references
+// (&amp;, &#1055;, &#x41F; ...) are decoded in place, so a reference inside
+// a word stays part of it.
+class HtmlScanner {
+private:
+    // A decoded character reference: up to four UTF-8 bytes.
+    struct Decoded {
+        char bytes[4];
+        size_t length;
+    };
+
+    // Index of the first '<' or '&' in html at or after i, or its size.
+    static size_t findMarkup(std::string_view html, size_t i);
+    // Returns the index just past the markup starting with '<' at html[i],
+    // including the element body for <script> and <style>. Returns i + 1
+    // if the '<' does not start markup.
+    static size_t skipMarkup(std::string_view html, size_t i);
+    // Decodes the reference starting with '&' at html[i] and returns the
+    // index just past it. Unknown references decode to the '&' alone.
+    static size_t decodeReference(std::string_view html, size_t i, Decoded& decoded);
+
+public:
+    // Calls sink(std::string_view token, size_t position) for every token,
+    // as Tokenizer::forEachToken does; positions are offsets into html.
+    template<typename Sink>
+    static void forEachToken(std::string_view html, Tokenizer& tokenizer, Sink sink) {
+        size_t i = 0;
+        while (i < html.size()) {
+            size_t next = findMarkup(html, i);
+            tokenizer.feed(html.substr(i, next - i), i, sink);
+            if (next == html.size()) break;
+
+            i = next;
+            if (html[i] == '&') {
+                Decoded decoded;
+                size_t end = decodeReference(html, i, decoded);
+                tokenizer.feed(std::string_view(decoded.bytes, decoded.length), i, sink);
+                i = end;
+            } else {
+                size_t end = skipMarkup(html, i);
+                tokenizer.endWord(sink);
+                i = end;
+            }
+        }
+        tokenizer.endWord(sink);
+    }
+};
+
+#endif
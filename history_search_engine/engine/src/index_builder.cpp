@@ -0,0 +1,60 @@
+#include "index_builder.h"
+#include <algorithm>
+#include <iostream>
+
+IndexBuilder::IndexBuilder(size_t threads, bool store_positions)
+    : num_threads(std::max<size_t>(1, threads)), store_positions(store_positions) {}
+
+void IndexBuilder::addDocument(const TokenizedBatch& batch, size_t i, InvertedIndex& index) {
+    index.beginDocument();
+    batch.forEachTerm(i, [&index](std::string_view stem) {
+        index.addTerm(stem);
+    });
+    index.endDocument(batch.url(i), batch.source(i));
+}
+
+void IndexBuilder::reportProgress(size_t before, size_t after) {
+    if (before / 500 != after / 500) {
+        std::cout << "✓ Processed " << after << " documents" << std::endl;
+    }
+}
+
+size_t IndexBuilder::build(DocumentSource& source, InvertedIndex& index, ZipfAnalyzer& zipf) {
+    IngestPipeline pipeline(num_threads);
+    size_t processed = 0;
+    index.setStorePositions(store_positions);
+    
+    pipeline.run(source, zipf, [&](const TokenizedBatch& batch) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            addDocument(batch, i, index);
+        }
+        reportProgress(processed, processed + batch.size());
+        processed += batch.size();
+        return true;
+    });
+    
+    pipeline.printReport();
+    return processed;
+}
+
+size_t IndexBuilder::buildStreaming(DocumentSource& source, SpimiIndexer& spimi,
+                                    ZipfAnalyzer& zipf) {
+    IngestPipeline pipeline(num_threads);
+    size_t processed = 0;
+    spimi.getIndex().setStorePositions(store_positions);
+    
+    // Spilling runs in the index stage, so the workers keep tokenizing
+    // ahead while a run is written. A failed spill stops the pipeline.
+    pipeline.run(source, zipf, [&](const TokenizedBatch& batch) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            addDocument(batch, i, spimi.getIndex());
+            if (!spimi.checkMemoryBudget()) return false;
+        }
+        reportProgress(processed, processed + batch.size());
+        processed += batch.size();
+        return true;
+    });
+    
+    pipeline.printReport();
+    return processed;
+}
@@ -0,0 +1,28 @@
+#ifndef INDEX_BUILDER_H
+#define INDEX_BUILDER_H
+
+#include <cstddef>
+#include "document_source.h"
+#include "ingest_pipeline.h"
+#include "inverted_index.h"
+#include "spimi_indexer.h"
+#include "zipf_analyzer.h"
+
+// Feeds documents through an IngestPipeline with `threads` tokenize/stem
+// workers and adds the stemmed batches to the index in input order, so doc
+// IDs and the saved index do not depend on the number of threads.
+class IndexBuilder {
+private:
+    size_t num_threads;
+    bool store_positions;
+    
+    static void addDocument(const TokenizedBatch& batch, size_t i, InvertedIndex& index);
+    static void reportProgress(size_t before, size_t after);
+    
+public:
+    explicit IndexBuilder(size_t threads = 1, bool store_positions = false);
+    size_t build(DocumentSource& source, InvertedIndex& index, ZipfAnalyzer& zipf);
+    size_t buildStreaming(DocumentSource& source, SpimiIndexer& spimi, ZipfAnalyzer& zipf);
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "index_file.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+IndexWriter::IndexWriter() : header(), offset(0), documents(nullptr), scorer(0, 0.0) {}
+
+void IndexWriter::write(const void* data, size_t size) {
+    out.write(static_cast<const char*>(data), size);
+    offset += size;
+}
+
+void IndexWriter::align(size_t alignment) {
+    static const char zeros[8] = {};
+    size_t padding = (alignment - offset % alignment) % alignment;
+    write(zeros, padding);
+}
+
+bool IndexWriter::open(const std::string& filename) {
+    this->filename = filename;
+    temp_filename = filename + ".tmp";
+    out.open(temp_filename, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Cannot open file for writing: " << temp_filename << std::endl;
+        return false;
+    }
+    
+    header = IndexHeader();
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    dictionary.clear();
+    term_data.clear();
+    offset = 0;
+    
+    write(&header, sizeof(header));
+    return true;
+}
+
+void IndexWriter::writeDocuments(const DocumentTable& documents) {
+    this->documents = &documents;
+    scorer = Bm25(documents.size(), documents.averageLength());
+    
+    align(8);
+    header.num_docs = documents.size();
+    header.documents_offset = offset;
+    
+    std::streampos start = out.tellp();
+    documents.save(out);
+    header.documents_size = static_cast<uint64_t>(out.tellp() - start);
+    offset += header.documents_size;
+}
+
+void IndexWriter::addTerm(const std::string& term, const PostingList& postings) {
+    align(4);
+    PostingView view = postings.view();
+    
+    TermEntry entry;
+    entry.term_offset = term_data.size();
+    entry.postings_offset = offset;
+    entry.term_length = static_cast<uint32_t>(term.length());
+    entry.count = view.count;
+    entry.last_doc = view.last_doc;
+    entry.num_blocks = view.num_blocks;
+    entry.num_words = view.num_words;
+    entry.tail_size = view.tail_size;
+    entry.num_position_blocks = view.positions.num_blocks;
+    entry.positions_size = view.positions.data_size;
+    entry.max_score = 0.0f;
+    entry.bitmap_words = 0;
+    
+    scored_blocks.assign(view.blocks, view.blocks + view.num_blocks);
+    if (documents) {
+        entry.max_score = scorer.maxScore(view, *documents, block_max);
+        for (size_t b = 0; b < scored_blocks.size(); ++b) {
+            double fraction = entry.max_score > 0 ? block_max[b] / entry.max_score : 1.0;
+            double units = std::ceil(fraction * 65535.0);
+            scored_blocks[b].score_bound = static_cast<uint16_t>(std::min(65535.0, std::max(1.0, units)));
+        }
+        
+        if (DocBitmap::isDense(view.count, documents->size())) {
+            bitmap.reset(static_cast<uint32_t>(documents->size()));
+            bitmap.assign(view);
+            entry.bitmap_words = static_cast<uint32_t>(bitmap.numWords());
+        }
+    }
+    dictionary.push_back(entry);
+    term_data += term;
+    
+    write(scored_blocks.data(), scored_blocks.size() * sizeof(PostingBlock));
+    write(view.packed, view.num_words * sizeof(uint32_t));
+    write(view.tail, view.tail_size);
+    
+    if (!view.positions.empty()) {
+        align(4);
+        write(view.positions.block_offsets, view.positions.num_blocks * sizeof(uint32_t));
+        write(view.positions.data, view.positions.data_size);
+    }
+    
+    if (entry.bitmap_words) {
+        align(8);
+        write(bitmap.data(), bitmap.numWords() * sizeof(uint64_t));
+    }
+}
+
+bool IndexWriter::finish() {
+    align(8);
+    header.terms_offset = offset;
+    header.terms_size = term_data.size();
+    write(term_data.data(), term_data.size());
+    
+    align(8);
+    header.vocab_size = dictionary.size();
+    header.dictionary_offset = offset;
+    write(dictionary.data(), dictionary.size() * sizeof(TermEntry));
+    header.file_size = offset;
+    
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    
+    if (!out) {
+        std::cerr << "Failed to write index file: " << temp_filename << std::endl;
+        std::remove(temp_filename.c_str());
+        return false;
+    }
+    if (std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Cannot replace index file: " << filename << std::endl;
+        std::remove(temp_filename.c_str());
+        return false;
+    }
+    return true;
+}
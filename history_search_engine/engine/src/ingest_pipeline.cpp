@@ -0,0 +1,247 @@
+#include "ingest_pipeline.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "html_scanner.h"
+#include "stem_cache.h"
+#include "tokenizer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t elapsedNs(Clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count();
+}
+
+double seconds(uint64_t ns) {
+    return ns / 1e9;
+}
+
+void printStage(const char* name, const StageStats& stats, const char* unit,
+                size_t threads, uint64_t wall_ns) {
+    double busy = seconds(stats.busy_ns);
+    double utilization = wall_ns ? 100.0 * stats.busy_ns / (double(wall_ns) * threads) : 0.0;
+    std::cout << "  " << std::left << std::setw(9) << name << std::right
+              << std::setw(9) << stats.items << " " << std::left << std::setw(6) << unit
+              << std::right << std::fixed << std::setprecision(3)
+              << " busy " << busy << " s";
+    if (threads > 1) std::cout << " over " << threads << " threads";
+    std::cout << std::setprecision(1) << " (" << utilization << "% utilized";
+    if (busy > 0) {
+        std::cout << ", " << std::setprecision(0) << stats.items / busy << " " << unit << "/s";
+    }
+    std::cout << ")" << std::defaultfloat << std::endl;
+}
+
+void printQueue(const char* name, const QueueStats& stats, size_t capacity) {
+    double average = stats.pushes ? double(stats.depth_sum) / stats.pushes : 0.0;
+    std::cout << "  " << std::left << std::setw(18) << name << std::right << std::fixed
+              << std::setprecision(1) << " depth avg " << average
+              << " max " << stats.max_depth << "/" << capacity
+              << std::setprecision(3) << ", producers blocked " << seconds(stats.full_wait_ns)
+              << " s, consumers starved " << seconds(stats.empty_wait_ns) << " s"
+              << std::defaultfloat << std::endl;
+}
+
+}
+
+void TokenizedBatch::beginDocument(std::string_view url, std::string_view source) {
+    documents.push_back({static_cast<uint32_t>(text.size()), static_cast<uint32_t>(url.size()),
+                         static_cast<uint32_t>(source.size()),
+                         static_cast<uint32_t>(term_ends.size())});
+    text += url;
+    text += source;
+}
+
+void TokenizedBatch::addTerm(std::string_view term) {
+    text += term;
+    term_ends.push_back(static_cast<uint32_t>(text.size()));
+}
+
+std::string_view TokenizedBatch::url(size_t i) const {
+    return std::string_view(text.data() + documents[i].start, documents[i].url_length);
+}
+
+std::string_view TokenizedBatch::source(size_t i) const {
+    const Document& doc = documents[i];
+    return std::string_view(text.data() + doc.start + doc.url_length, doc.source_length);
+}
+
+IngestPipeline::IngestPipeline(size_t workers, size_t batch_bytes)
+    : num_workers(std::max<size_t>(1, workers)), batch_bytes(std::max<size_t>(1, batch_bytes)),
+      tokens(0), stem_hits(0), stem_misses(0), wall_ns(0) {}
+
+size_t IngestPipeline::run(DocumentSource& source, ZipfAnalyzer& zipf,
+                           const std::function<bool(const TokenizedBatch&)>& consume) {
+    auto started = Clock::now();
+    BoundedQueue<RawBatch> raw_batches(2 * num_workers);
+    BoundedQueue<TokenizedBatch> tokenized_batches(2 * num_workers);
+
+    // The reader stays at most `window` batches ahead of the index stage,
+    // which bounds the batches queued, being tokenized and held back for
+    // reordering below.
+    const uint64_t window = 4 * num_workers;
+    std::mutex window_mutex;
+    std::condition_variable window_open;
+    uint64_t consumed = 0;
+    bool stopped = false;
+
+    std::thread read_thread([&] {
+        uint64_t sequence = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(window_mutex);
+                window_open.wait(lock, [&] { return sequence - consumed < window || stopped; });
+                if (stopped) break;
+            }
+
+            auto start = Clock::now();
+            RawBatch raw;
+            bool more = source.read(raw, batch_bytes);
+            read_stats.busy_ns += elapsedNs(start);
+            if (!more) break;
+
+            raw.sequence = sequence++;
+            read_stats.batches++;
+            read_stats.items += raw.bytes();
+            if (!raw_batches.push(std::move(raw))) break;
+        }
+        raw_batches.close();
+    });
+
+    std::vector<StageStats> worker_stats(num_workers);
+    std::vector<ZipfAnalyzer> worker_zipf(num_workers);
+    std::vector<uint64_t> worker_tokens(num_workers, 0);
+    std::vector<uint64_t> worker_hits(num_workers, 0);
+    std::vector<uint64_t> worker_misses(num_workers, 0);
+
+    auto tokenize = [&](size_t w) {
+        Tokenizer tokenizer;
+        StemCache stems;
+        RawBatch raw;
+        while (raw_batches.pop(raw)) {
+            auto start = Clock::now();
+            TokenizedBatch batch;
+            batch.sequence = raw.sequence;
+            batch.text.reserve(raw.bytes() / 2);
+
+            raw.forEachDocument([&](const DocumentView& doc) {
+                batch.beginDocument(doc.url, doc.source);
+                HtmlScanner::forEachToken(doc.html_content, tokenizer,
+                                          [&](std::string_view token, size_t) {
+                    const std::string& stem = stems.stem(token);
+                    worker_zipf[w].addTerm(stem);
+                    batch.addTerm(stem);
+                });
+            });
+
+            worker_stats[w].batches++;
+            worker_stats[w].items += batch.size();
+            worker_tokens[w] += batch.term_ends.size();
+            worker_stats[w].busy_ns += elapsedNs(start);
+            tokenized_batches.push(std::move(batch));
+        }
+        worker_hits[w] = stems.getHits();
+        worker_misses[w] = stems.getMisses();
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < num_workers; ++w) {
+        workers.emplace_back(tokenize, w);
+    }
+    std::thread close_thread([&] {
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        tokenized_batches.close();
+    });
+
+    // Stops the reader and makes the workers drop what is left, so that
+    // every thread can be joined.
+    auto stop = [&] {
+        {
+            std::lock_guard<std::mutex> lock(window_mutex);
+            stopped = true;
+        }
+        window_open.notify_one();
+        raw_batches.close();
+        tokenized_batches.close();
+    };
+
+    // Workers finish batches out of order; hold early ones back until
+    // their predecessors have been consumed.
+    std::map<uint64_t, TokenizedBatch> pending;
+    uint64_t next_sequence = 0;
+    TokenizedBatch batch;
+    bool more = true;
+    try {
+        while (more && tokenized_batches.pop(batch)) {
+            uint64_t sequence = batch.sequence;
+            pending.emplace(sequence, std::move(batch));
+
+            for (auto it = pending.begin(); it != pending.end() && it->first == next_sequence;
+                 it = pending.erase(it), ++next_sequence) {
+                auto start = Clock::now();
+                more = consume(it->second);
+                index_stats.batches++;
+                index_stats.items += it->second.size();
+                index_stats.busy_ns += elapsedNs(start);
+                if (!more) {
+                    stop();
+                    break;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(window_mutex);
+                    consumed = next_sequence + 1;
+                }
+                window_open.notify_one();
+            }
+        }
+    } catch (...) {
+        stop();
+        read_thread.join();
+        close_thread.join();
+        throw;
+    }
+
+    read_thread.join();
+    close_thread.join();
+
+    for (size_t w = 0; w < num_workers; ++w) {
+        tokenize_stats.batches += worker_stats[w].batches;
+        tokenize_stats.items += worker_stats[w].items;
+        tokenize_stats.busy_ns += worker_stats[w].busy_ns;
+        tokens += worker_tokens[w];
+        stem_hits += worker_hits[w];
+        stem_misses += worker_misses[w];
+        zipf.merge(worker_zipf[w]);
+    }
+    read_queue = raw_batches.stats();
+    index_queue = tokenized_batches.stats();
+    wall_ns = elapsedNs(started);
+    return index_stats.items;
+}
+
+void IngestPipeline::printReport() const {
+    std::cout << "Pipeline stages (" << seconds(wall_ns) << " s wall):" << std::endl;
+    printStage("read", read_stats, "bytes", 1, wall_ns);
+    printStage("tokenize", tokenize_stats, "docs", num_workers, wall_ns);
+    printStage("index", index_stats, "docs", 1, wall_ns);
+    printQueue("read -> tokenize", read_queue, 2 * num_workers);
+    printQueue("tokenize -> index", index_queue, 2 * num_workers);
+
+    uint64_t lookups = stem_hits + stem_misses;
+    std::cout << "Tokens: " << tokens;
+    if (lookups > 0) {
+        std::cout << ", stem cache " << stem_hits << "/" << lookups << " hits ("
+                  << 100.0 * stem_hits / lookups << "%)";
+    }
+    std::cout << std::endl;
+}
@@ -0,0 +1,100 @@
+#ifndef INGEST_PIPELINE_H
+#define INGEST_PIPELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "bounded_queue.h"
+#include "document_source.h"
+#include "zipf_analyzer.h"
+
+// Stemmed documents of one input batch. The URL, source and stems of each
+// document are stored back to back in `text`.
+struct TokenizedBatch {
+    struct Document {
+        uint32_t start;
+        uint32_t url_length;
+        uint32_t source_length;
+        uint32_t first_term;
+    };
+
+    uint64_t sequence = 0;
+    std::string text;
+    // End offset in `text` of every stem.
+    std::vector<uint32_t> term_ends;
+    std::vector<Document> documents;
+
+    void beginDocument(std::string_view url, std::string_view source);
+    void addTerm(std::string_view term);
+
+    size_t size() const { return documents.size(); }
+    std::string_view url(size_t i) const;
+    std::string_view source(size_t i) const;
+
+    // Calls fn(std::string_view stem) for the stems of document i in order.
+    template<typename Fn>
+    void forEachTerm(size_t i, Fn fn) const {
+        const Document& doc = documents[i];
+        uint32_t end = i + 1 < documents.size() ? documents[i + 1].first_term
+                                                : static_cast<uint32_t>(term_ends.size());
+        size_t pos = doc.start + doc.url_length + doc.source_length;
+        for (uint32_t k = doc.first_term; k < end; ++k) {
+            fn(std::string_view(text.data() + pos, term_ends[k] - pos));
+            pos = term_ends[k];
+        }
+    }
+};
+
+struct StageStats {
+    uint64_t batches = 0;
+    uint64_t items = 0;
+    uint64_t busy_ns = 0;
+};
+
+// Builds the index input in three stages connected by bounded queues:
+//
+//   read      pulls batches from the DocumentSource, such as whole lines
+//             of a mapped file or a database cursor, so that I/O
+//             overlaps with work
+//   tokenize  N workers parse the records, tokenize the HTML and stem the
+//             tokens into TokenizedBatches, counting terms for Zipf
+//   index     the calling thread receives the batches in file order
+//
+// Full queues block the stage feeding them, and the reader never runs more
+// than a fixed window of batches ahead of the index stage, so a slow index
+// stage or one slow batch holds back the workers and the reader instead of
+// letting batches pile up in the reorder buffer.
+// Per-stage busy time and queue depths are kept for printReport().
+class IngestPipeline {
+private:
+    size_t num_workers;
+    size_t batch_bytes;
+    StageStats read_stats;
+    StageStats tokenize_stats;
+    StageStats index_stats;
+    uint64_t tokens;
+    uint64_t stem_hits;
+    uint64_t stem_misses;
+    uint64_t wall_ns;
+    QueueStats read_queue;
+    QueueStats index_queue;
+
+public:
+    static constexpr size_t DEFAULT_BATCH_BYTES = 256 * 1024;
+
+    explicit IngestPipeline(size_t workers, size_t batch_bytes = DEFAULT_BATCH_BYTES);
+
+    // Runs all stages over the documents of source and calls consume on
+    // this thread for every batch, in input order. Term counts of all
+    // workers are merged into zipf. Returns the number of documents
+    // consumed. If consume returns false or throws, all threads are
+    // stopped and joined before run() returns or the exception propagates.
+    size_t run(DocumentSource& source, ZipfAnalyzer& zipf,
+               const std::function<bool(const TokenizedBatch&)>& consume);
+    void printReport() const;
+};
+
+#endif
@@ -1,148 +1,344 @@
 #include "inverted_index.h"
-#include <fstream>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include "posting_iterator.h"
 
-InvertedIndex::InvertedIndex() : total_docs(0) {}
+// Rough per-term cost of a hash table slot (key, hash, control byte; the
+// PostingList itself is counted by memoryUsage()) at a typical load factor.
+static const size_t TERM_OVERHEAD = 2 * (sizeof(std::string) + sizeof(uint64_t) + 1);
 
-void InvertedIndex::addDocument(const std::string& doc_id, const std::vector<Token>& tokens) {
-    documents.push_back(doc_id);
+InvertedIndex::InvertedIndex()
+    : total_docs(0), memory_usage(0), store_positions(false), generation(0), doc_tokens(0), dictionary(nullptr), term_data(nullptr), mapped_vocab(0) {}
+
+void InvertedIndex::beginDocument() {
+    term_freq.reset(0);
+    token_terms.clear();
+    doc_tokens = 0;
+}
+
+void InvertedIndex::addTerm(std::string_view term) {
+    uint32_t term_id = term_freq.add(term);
+    if (store_positions) {
+        token_terms.push_back(term_id);
+    }
+    doc_tokens++;
+}
+
+uint32_t InvertedIndex::endDocument(std::string_view url, std::string_view source) {
+    uint32_t doc_id = documents.add(url, source, doc_tokens);
     total_docs++;
+    generation++;
     
-    HashTable<int> term_freq;
-    
-    for (const auto& token : tokens) {
-        int freq = 0;
-        if (term_freq.find(token.text, freq)) {
-            term_freq.insert(token.text, freq + 1);
-        } else {
-            term_freq.insert(token.text, 1);
+    if (store_positions) {
+        // Counting sort of the token ordinals by term id.
+        term_starts.assign(term_freq.size() + 1, 0);
+        for (uint32_t term : token_terms) {
+            term_starts[term + 1]++;
+        }
+        for (size_t t = 1; t < term_starts.size(); ++t) {
+            term_starts[t] += term_starts[t - 1];
+        }
+        grouped_positions.resize(token_terms.size());
+        for (size_t i = 0; i < token_terms.size(); ++i) {
+            grouped_positions[term_starts[token_terms[i]]++] = static_cast<uint32_t>(i);
         }
     }
     
-    term_freq.iterate([this, &doc_id](const std::string& term, const int& freq) {
-        PostingList pl;
-        if (index.find(term, pl)) {
-            pl.doc_ids.push_back(doc_id);
-            pl.frequencies.push_back(freq);
-            index.insert(term, pl);
+    uint32_t term_id = 0;
+    term_freq.forEach([this, doc_id, &term_id](std::string_view term, int freq) {
+        auto slot = index.try_emplace(term);
+        if (slot.second) {
+            memory_usage += TERM_OVERHEAD + term.length() + slot.first->memoryUsage();
+        }
+        size_t before = slot.first->memoryUsage();
+        if (store_positions) {
+            // term_starts[t] now points at the end of term t's positions.
+            slot.first->add(doc_id, freq, grouped_positions.data() + term_starts[term_id] - freq);
         } else {
-            PostingList new_pl;
-            new_pl.doc_ids.push_back(doc_id);
-            new_pl.frequencies.push_back(freq);
-            index.insert(term, new_pl);
+            slot.first->add(doc_id, freq);
         }
+        memory_usage += slot.first->memoryUsage() - before;
+        term_id++;
     });
+    
+    return doc_id;
 }
 
-PostingList* InvertedIndex::getPostingList(const std::string& term) {
+PostingList* InvertedIndex::getPostingList(std::string_view term) {
     return index.get(term);
 }
 
-size_t InvertedIndex::getVocabularySize() const {
-    return index.size();
+PostingView InvertedIndex::getPostings(std::string_view term) const {
+    if (dictionary) {
+        return findMapped(term);
+    }
+    
+    const PostingList* pl = index.get(term);
+    return pl ? pl->view() : PostingView();
 }
 
-size_t InvertedIndex::getTotalDocuments() const {
-    return total_docs;
+PostingView InvertedIndex::findMapped(std::string_view term) const {
+    const TermEntry* end = dictionary + mapped_vocab;
+    const TermEntry* it = std::lower_bound(dictionary, end, term,
+        [this](const TermEntry& entry, std::string_view key) {
+            return std::string_view(term_data + entry.term_offset, entry.term_length) < key;
+        });
+    if (it == end || std::string_view(term_data + it->term_offset, it->term_length) != term) {
+        return PostingView();
+    }
+    return mappedView(*it);
 }
 
-void InvertedIndex::saveToFile(const std::string& filename) {
-    std::ofstream out(filename, std::ios::binary);
-    if (!out.is_open()) {
-        std::cerr << "Cannot open file for writing: " << filename << std::endl;
-        return;
+size_t InvertedIndex::postingsLayout(const TermEntry& entry, size_t& positions_start,
+                                     size_t& bitmap_start) {
+    size_t tail_end = size_t(entry.num_blocks) * sizeof(PostingBlock) +
+                      size_t(entry.num_words) * sizeof(uint32_t) + entry.tail_size;
+    positions_start = entry.num_position_blocks ? (tail_end + 3) & ~size_t(3) : tail_end;
+    size_t bytes = positions_start + size_t(entry.num_position_blocks) * sizeof(uint32_t) +
+                   entry.positions_size;
+    bitmap_start = 0;
+    if (entry.bitmap_words) {
+        // Bitmaps are aligned within the file, not within the postings.
+        bitmap_start = ((entry.postings_offset + bytes + 7) & ~size_t(7)) - entry.postings_offset;
+        bytes = bitmap_start + size_t(entry.bitmap_words) * sizeof(uint64_t);
     }
+    return bytes;
+}
+
+bool InvertedIndex::validEntry(const TermEntry& entry, uint64_t terms_size, uint64_t file_size) {
+    size_t positions_start, bitmap_start;
+    return entry.term_offset <= terms_size && terms_size - entry.term_offset >= entry.term_length &&
+           entry.postings_offset % 4 == 0 && entry.postings_offset <= file_size &&
+           file_size - entry.postings_offset >= postingsLayout(entry, positions_start, bitmap_start);
+}
+
+PostingView InvertedIndex::mappedView(const TermEntry& entry) const {
+    // Every entry was checked against the file by loadFromFile.
+    const TermEntry* it = &entry;
+    size_t positions_start, bitmap_start;
+    postingsLayout(entry, positions_start, bitmap_start);
     
-    size_t num_docs = documents.size();
-    out.write(reinterpret_cast<const char*>(&num_docs), sizeof(size_t));
+    const char* base = mapped.begin() + it->postings_offset;
+    const char* p = base;
+    PostingView view;
+    view.blocks = reinterpret_cast<const PostingBlock*>(p);
+    p += it->num_blocks * sizeof(PostingBlock);
+    view.packed = reinterpret_cast<const uint32_t*>(p);
+    p += it->num_words * sizeof(uint32_t);
+    view.tail = reinterpret_cast<const uint8_t*>(p);
+    view.num_blocks = it->num_blocks;
+    view.num_words = it->num_words;
+    view.tail_size = it->tail_size;
+    view.count = it->count;
+    view.last_doc = it->last_doc;
     
-    for (const auto& doc : documents) {
-        size_t len = doc.length();
-        out.write(reinterpret_cast<const char*>(&len), sizeof(size_t));
-        out.write(doc.c_str(), len);
+    p = base + positions_start;
+    view.positions.block_offsets = reinterpret_cast<const uint32_t*>(p);
+    view.positions.data = reinterpret_cast<const uint8_t*>(p + it->num_position_blocks * sizeof(uint32_t));
+    view.positions.num_blocks = it->num_position_blocks;
+    view.positions.data_size = it->positions_size;
+    view.max_score = it->max_score;
+    if (it->bitmap_words) {
+        view.bitmap = reinterpret_cast<const uint64_t*>(base + bitmap_start);
+        view.bitmap_words = it->bitmap_words;
     }
+    return view;
+}
+
+std::string InvertedIndex::getUrl(uint32_t doc_id) const {
+    return documents.getUrl(doc_id);
+}
+
+const std::string& InvertedIndex::getSource(uint32_t doc_id) const {
+    return documents.getSource(doc_id);
+}
+
+std::vector<uint32_t> InvertedIndex::appendLive(const InvertedIndex& source,
+                                                const DocBitmap* deleted) {
+    generation++;
+    const DocumentTable& source_docs = source.documents;
+    std::vector<uint32_t> new_ids(source_docs.size(), DROPPED);
+    source_docs.forEachUrl([&](uint32_t doc_id, std::string_view url) {
+        if (deleted && deleted->test(doc_id)) return;
+        new_ids[doc_id] = documents.add(url, source_docs.getSource(doc_id),
+                                        source_docs.getLength(doc_id));
+        total_docs++;
+    });
     
-    size_t vocab_size = index.size();
-    out.write(reinterpret_cast<const char*>(&vocab_size), sizeof(size_t));
-    
-    index.iterate([&out](const std::string& term, const PostingList& pl) {
-        size_t term_len = term.length();
-        out.write(reinterpret_cast<const char*>(&term_len), sizeof(size_t));
-        out.write(term.c_str(), term_len);
-        
-        size_t num_postings = pl.doc_ids.size();
-        out.write(reinterpret_cast<const char*>(&num_postings), sizeof(size_t));
+    std::vector<uint32_t> positions;
+    source.forEachTerm([&](std::string_view term, const PostingView& postings) {
+        PostingList* target = nullptr;
+        size_t before = 0;
         
-        for (size_t i = 0; i < num_postings; ++i) {
-            size_t doc_len = pl.doc_ids[i].length();
-            out.write(reinterpret_cast<const char*>(&doc_len), sizeof(size_t));
-            out.write(pl.doc_ids[i].c_str(), doc_len);
+        for (PostingIterator it(postings); !it.atEnd(); it.next()) {
+            uint32_t doc_id = new_ids[it.docId()];
+            if (doc_id == DROPPED) continue;
             
-            int freq = pl.frequencies[i];
-            out.write(reinterpret_cast<const char*>(&freq), sizeof(int));
+            if (!target) {
+                auto slot = index.try_emplace(term);
+                if (slot.second) {
+                    memory_usage += TERM_OVERHEAD + term.length() + slot.first->memoryUsage();
+                }
+                target = slot.first;
+                before = target->memoryUsage();
+            }
+            if (store_positions) {
+                it.positions(positions);
+                target->add(doc_id, it.freq(), positions.data());
+            } else {
+                target->add(doc_id, it.freq());
+            }
         }
+        if (target) memory_usage += target->memoryUsage() - before;
     });
     
-    out.close();
-    std::cout << "Index saved to: " << filename << std::endl;
+    return new_ids;
 }
 
-void InvertedIndex::loadFromFile(const std::string& filename) {
-    std::ifstream in(filename, std::ios::binary);
-    if (!in.is_open()) {
-        std::cerr << "Cannot open file for reading: " << filename << std::endl;
+void InvertedIndex::forEachTerm(
+    const std::function<void(std::string_view, const PostingView&)>& fn) const {
+    if (dictionary) {
+        for (size_t i = 0; i < mapped_vocab; ++i) {
+            const TermEntry& entry = dictionary[i];
+            fn(std::string_view(term_data + entry.term_offset, entry.term_length), mappedView(entry));
+        }
         return;
     }
     
-    size_t num_docs;
-    in.read(reinterpret_cast<char*>(&num_docs), sizeof(size_t));
+    index.iterate([&fn](const std::string& term, const PostingList& pl) {
+        fn(term, pl.view());
+    });
+}
+
+size_t InvertedIndex::getVocabularySize() const {
+    return dictionary ? mapped_vocab : index.size();
+}
+
+size_t InvertedIndex::getTotalDocuments() const {
+    return total_docs;
+}
+
+const DocumentTable& InvertedIndex::getDocuments() const {
+    return documents;
+}
+
+void InvertedIndex::clearPostings() {
+    index = HashTable<PostingList>();
+    memory_usage = 0;
+    generation++;
+}
+
+void InvertedIndex::writeTermRecord(std::ostream& out, const std::string& term,
+                                    const PostingList& pl) {
+    size_t term_len = term.length();
+    out.write(reinterpret_cast<const char*>(&term_len), sizeof(size_t));
+    out.write(term.c_str(), term_len);
     
-    documents.clear();
-    for (size_t i = 0; i < num_docs; ++i) {
-        size_t len;
-        in.read(reinterpret_cast<char*>(&len), sizeof(size_t));
-        
-        std::string doc;
-        doc.resize(len);
-        in.read(&doc[0], len);
-        documents.push_back(doc);
+    pl.save(out);
+}
+
+bool InvertedIndex::readTermRecord(std::istream& in, std::string& term, PostingList& pl) {
+    size_t term_len;
+    if (!in.read(reinterpret_cast<char*>(&term_len), sizeof(size_t))) {
+        return false;
     }
     
-    total_docs = documents.size();
+    term.resize(term_len);
+    in.read(&term[0], term_len);
     
-    size_t vocab_size;
-    in.read(reinterpret_cast<char*>(&vocab_size), sizeof(size_t));
+    return pl.load(in);
+}
+
+void InvertedIndex::savePostings(std::ostream& out) const {
+    size_t vocab_size = index.size();
+    out.write(reinterpret_cast<const char*>(&vocab_size), sizeof(size_t));
     
-    for (size_t i = 0; i < vocab_size; ++i) {
-        size_t term_len;
-        in.read(reinterpret_cast<char*>(&term_len), sizeof(size_t));
-        
-        std::string term;
-        term.resize(term_len);
-        in.read(&term[0], term_len);
-        
-        size_t num_postings;
-        in.read(reinterpret_cast<char*>(&num_postings), sizeof(size_t));
-        
-        PostingList pl;
-        for (size_t j = 0; j < num_postings; ++j) {
-            size_t doc_len;
-            in.read(reinterpret_cast<char*>(&doc_len), sizeof(size_t));
-            
-            std::string doc_id;
-            doc_id.resize(doc_len);
-            in.read(&doc_id[0], doc_len);
-            
-            int freq;
-            in.read(reinterpret_cast<char*>(&freq), sizeof(int));
-            
-            pl.doc_ids.push_back(doc_id);
-            pl.frequencies.push_back(freq);
-        }
-        
-        index.insert(term, pl);
+    std::vector<std::pair<const std::string*, const PostingList*>> entries;
+    entries.reserve(vocab_size);
+    index.iterate([&entries](const std::string& term, const PostingList& pl) {
+        entries.emplace_back(&term, &pl);
+    });
+    std::sort(entries.begin(), entries.end(),
+              [](const auto& a, const auto& b) { return *a.first < *b.first; });
+    
+    for (const auto& entry : entries) {
+        writeTermRecord(out, *entry.first, *entry.second);
+    }
+}
+
+bool InvertedIndex::saveToFile(const std::string& filename) {
+    IndexWriter writer;
+    if (!writer.open(filename)) return false;
+    
+    writer.writeDocuments(documents);
+    
+    std::vector<std::pair<const std::string*, const PostingList*>> entries;
+    entries.reserve(index.size());
+    index.iterate([&entries](const std::string& term, const PostingList& pl) {
+        entries.emplace_back(&term, &pl);
+    });
+    std::sort(entries.begin(), entries.end(),
+              [](const auto& a, const auto& b) { return *a.first < *b.first; });
+    
+    for (const auto& entry : entries) {
+        writer.addTerm(*entry.first, *entry.second);
+    }
+    
+    if (!writer.finish()) return false;
+    std::cout << "Index saved to: " << filename << std::endl;
+    return true;
+}
+
+bool InvertedIndex::loadFromFile(const std::string& filename) {
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    
+    IndexHeader header;
+    if (file.size() < sizeof(header)) {
+        std::cerr << "Not an index file: " << filename << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file.begin(), sizeof(header));
+    
+    if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) != 0) {
+        std::cerr << "Not an index file: " << filename << std::endl;
+        return false;
+    }
+    if (header.version != INDEX_VERSION) {
+        std::cerr << "Unsupported index version " << header.version
+                  << " (expected " << INDEX_VERSION << "): " << filename << std::endl;
+        return false;
     }
     
-    in.close();
+    size_t size = file.size();
+    bool valid = header.file_size == size &&
+                 header.documents_offset <= size && size - header.documents_offset >= header.documents_size &&
+                 header.terms_offset <= size && size - header.terms_offset >= header.terms_size &&
+                 header.dictionary_offset % alignof(TermEntry) == 0 &&
+                 header.dictionary_offset <= size &&
+                 (size - header.dictionary_offset) / sizeof(TermEntry) >= header.vocab_size;
+    const TermEntry* entries = reinterpret_cast<const TermEntry*>(file.begin() + header.dictionary_offset);
+    for (uint64_t i = 0; valid && i < header.vocab_size; ++i) {
+        valid = validEntry(entries[i], header.terms_size, size);
+    }
+    if (!valid || !documents.attach(file.begin() + header.documents_offset, header.documents_size)) {
+        std::cerr << "Corrupted index file: " << filename << std::endl;
+        documents.clear();
+        return false;
+    }
+    
+    index = HashTable<PostingList>();
+    memory_usage = 0;
+    mapped = std::move(file);
+    dictionary = entries;
+    term_data = mapped.begin() + header.terms_offset;
+    mapped_vocab = header.vocab_size;
+    // Positional indexes have position data for every term.
+    store_positions = mapped_vocab > 0 && dictionary[0].num_position_blocks > 0;
+    total_docs = documents.size();
+    generation++;
+    
     std::cout << "Index loaded from: " << filename << std::endl;
+    return true;
 }
@@ -1,30 +1,95 @@
 #ifndef INVERTED_INDEX_H
 #define INVERTED_INDEX_H
 
+#include <cstdint>
+#include <functional>
+#include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "doc_bitmap.h"
 #include "hash_table.h"
-#include "tokenizer.h"
-
-struct PostingList {
-    std::vector<std::string> doc_ids;
-    std::vector<int> frequencies;
-};
+#include "document_table.h"
+#include "index_file.h"
+#include "mapped_file.h"
+#include "posting_list.h"
+#include "term_accumulator.h"
 
 class InvertedIndex {
+public:
+    static constexpr uint32_t DROPPED = 0xFFFFFFFFu;
+    
 private:
     HashTable<PostingList> index;
-    std::vector<std::string> documents;
+    DocumentTable documents;
+    TermAccumulator term_freq;
     size_t total_docs;
+    size_t memory_usage;
+    bool store_positions;
+    // Bumped whenever the contents change, so that cached results of an
+    // older state can be told apart.
+    uint64_t generation;
+    
+    // Per-document scratch: the token count and, with positions, every
+    // token's term id and the positions grouped by term.
+    uint32_t doc_tokens;
+    std::vector<uint32_t> token_terms;
+    std::vector<uint32_t> term_starts;
+    std::vector<uint32_t> grouped_positions;
+    
+    // Set by loadFromFile(): the dictionary and postings are read in place.
+    MappedFile mapped;
+    const TermEntry* dictionary;
+    const char* term_data;
+    size_t mapped_vocab;
+    
+    PostingView findMapped(std::string_view term) const;
+    PostingView mappedView(const TermEntry& entry) const;
+    // Bytes of a term's postings; positions and the bitmap start at the
+    // returned offsets from postings_offset.
+    static size_t postingsLayout(const TermEntry& entry, size_t& positions_start,
+                                 size_t& bitmap_start);
+    // Whether the term and postings of entry lie within their sections.
+    static bool validEntry(const TermEntry& entry, uint64_t terms_size, uint64_t file_size);
     
 public:
     InvertedIndex();
-    void addDocument(const std::string& doc_id, const std::vector<Token>& tokens);
-    PostingList* getPostingList(const std::string& term);
+    // Keep the word positions (token ordinals) of every posting, which
+    // phrase and NEAR queries need. Off by default.
+    void setStorePositions(bool enabled) { store_positions = enabled; }
+    bool storesPositions() const { return store_positions; }
+    // Adds a document: beginDocument(), addTerm() for every token in
+    // order, then endDocument(), which returns the doc ID.
+    void beginDocument();
+    void addTerm(std::string_view term);
+    uint32_t endDocument(std::string_view url, std::string_view source = "");
+    // Mutable postings of an index being built; nullptr for a loaded index.
+    PostingList* getPostingList(std::string_view term);
+    // Postings of a term in either mode; empty if the term is unknown.
+    PostingView getPostings(std::string_view term) const;
+    std::string getUrl(uint32_t doc_id) const;
+    const std::string& getSource(uint32_t doc_id) const;
+    // Appends the documents of source not marked in `deleted` (which may
+    // be null) with their postings, renumbered after the existing ones.
+    // Returns the new doc ID of every source document, or DROPPED.
+    std::vector<uint32_t> appendLive(const InvertedIndex& source, const DocBitmap* deleted);
+    // Calls fn(term, postings) for every term; sorted by term for a
+    // loaded index, in no particular order otherwise.
+    void forEachTerm(const std::function<void(std::string_view, const PostingView&)>& fn) const;
     size_t getVocabularySize() const;
     size_t getTotalDocuments() const;
-    void saveToFile(const std::string& filename);
-    void loadFromFile(const std::string& filename);
+    // Terms and postings only, which clearPostings() frees.
+    size_t getPostingsMemoryUsage() const { return memory_usage; }
+    const DocumentTable& getDocuments() const;
+    uint64_t getGeneration() const { return generation; }
+    void clearPostings();
+    void savePostings(std::ostream& out) const;
+    bool saveToFile(const std::string& filename);
+    bool loadFromFile(const std::string& filename);
+    
+    static void writeTermRecord(std::ostream& out, const std::string& term,
+                                const PostingList& pl);
+    static bool readTermRecord(std::istream& in, std::string& term, PostingList& pl);
 };
 
 #endif
@@ -1,119 +1,271 @@
 #include "json_reader.h"
-#include <fstream>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
-#include <sstream>
+#include <sys/stat.h>
+#include "utf8.h"
 
-std::vector<DocumentData> JSONReader::readFromFile(const std::string& filename) {
-    std::vector<DocumentData> documents;
-    std::ifstream file(filename);
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr size_t PAGE_SIZE = 4096;
+
+// Decoded copies of the fields that contain escapes.
+struct FieldBuffers {
+    std::string key;
+    std::string url;
+    std::string html_content;
+    std::string source;
+};
+
+const char* skipSpace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+    return p;
+}
+
+// First '"' or '\\' in [p, end), or end.
+const char* findQuoteOrEscape(const char* p, const char* end) {
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
     
-    if (!file.is_open()) {
-        std::cerr << "Error: Cannot open file " << filename << std::endl;
-        return documents;
+    for (; p + 16 <= end; p += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, quote),
+                                                  _mm_cmpeq_epi8(bytes, backslash)));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\') ++p;
+    return p;
+}
+
+bool parseHex4(const char* p, const char* end, uint32_t& value) {
+    if (end - p < 4) return false;
+    value = 0;
+    for (int k = 0; k < 4; ++k) {
+        char c = p[k];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+// Decodes the escape after the backslash at p into out; returns the
+// position after it, or nullptr if it is malformed.
+const char* decodeEscape(const char* p, const char* end, std::string& out) {
+    if (++p == end) return nullptr;
+    
+    switch (*p) {
+        case '"': out += '"'; return p + 1;
+        case '\\': out += '\\'; return p + 1;
+        case '/': out += '/'; return p + 1;
+        case 'b': out += '\b'; return p + 1;
+        case 'f': out += '\f'; return p + 1;
+        case 'n': out += '\n'; return p + 1;
+        case 'r': out += '\r'; return p + 1;
+        case 't': out += '\t'; return p + 1;
+        case 'u': break;
+        default: return nullptr;
     }
     
-    std::string line;
-    int count = 0;
+    uint32_t code_point;
+    if (!parseHex4(p + 1, end, code_point)) return nullptr;
+    p += 5;
     
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-        
-        DocumentData doc;
+    // A high surrogate followed by an escaped low surrogate is one
+    // character; any other surrogate is replaced.
+    uint32_t low;
+    if (code_point >= 0xD800 && code_point <= 0xDBFF && end - p >= 6 &&
+        p[0] == '\\' && p[1] == 'u' && parseHex4(p + 2, end, low) &&
+        low >= 0xDC00 && low <= 0xDFFF) {
+        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+        p += 6;
+    } else if (isSurrogate(code_point)) {
+        code_point = REPLACEMENT_CHARACTER;
+    }
+    
+    char bytes[4];
+    out.append(bytes, encodeUtf8(code_point, bytes));
+    return p;
+}
+
+// Parses the string starting at the quote at p. value views the raw bytes
+// when there are no escapes and the decoded copy in buffer otherwise.
+// Returns the position after the closing quote, or nullptr.
+const char* parseString(const char* p, const char* end, std::string& buffer,
+                        std::string_view& value) {
+    const char* start = ++p;
+    p = findQuoteOrEscape(p, end);
+    if (p == end) return nullptr;
+    if (*p == '"') {
+        value = std::string_view(start, p - start);
+        return p + 1;
+    }
+    
+    buffer.assign(start, p);
+    while (*p == '\\') {
+        p = decodeEscape(p, end, buffer);
+        if (!p) return nullptr;
         
-        size_t url_start = line.find("\"url\":\"") + 7;
-        size_t url_end = line.find("\"", url_start);
-        if (url_start != std::string::npos && url_end != std::string::npos) {
-            doc.url = line.substr(url_start, url_end - url_start);
+        const char* run = p;
+        p = findQuoteOrEscape(p, end);
+        if (p == end) return nullptr;
+        buffer.append(run, p);
+    }
+    value = buffer;
+    return p + 1;
+}
+
+// Skips the string starting at the quote at p without decoding it.
+const char* skipString(const char* p, const char* end) {
+    ++p;
+    while ((p = findQuoteOrEscape(p, end)) != end) {
+        if (*p == '"') return p + 1;
+        p += 2;
+    }
+    return nullptr;
+}
+
+// Skips any JSON value; strings inside objects and arrays are skipped as
+// a whole so that brackets in them are not counted.
+const char* skipValue(const char* p, const char* end) {
+    if (*p == '"') return skipString(p, end);
+    
+    size_t depth = 0;
+    while (p < end) {
+        char c = *p;
+        if (c == '"') {
+            p = skipString(p, end);
+            if (!p) return nullptr;
+            continue;
         }
-        
-        size_t html_start = line.find("\"html_content\":\"") + 16;
-        size_t html_end = line.find("\",\"source", html_start);
-        if (html_start != std::string::npos && html_end != std::string::npos) {
-            doc.html_content = line.substr(html_start, html_end - html_start);
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (depth == 0) return p;
+            if (--depth == 0) return p + 1;
+        } else if (depth == 0 && (c == ',' || c == ' ' || c == '\t' || c == '\r')) {
+            return p;
         }
+        ++p;
+    }
+    return depth == 0 ? p : nullptr;
+}
+
+bool parseRecord(std::string_view line, DocumentView& doc, FieldBuffers& buffers) {
+    const char* end = line.data() + line.size();
+    const char* p = skipSpace(line.data(), end);
+    if (p == end || *p != '{') return false;
+    
+    doc = DocumentView();
+    p = skipSpace(p + 1, end);
+    if (p < end && *p == '}') return false;
+    
+    while (p < end) {
+        std::string_view key;
+        if (*p != '"' || !(p = parseString(p, end, buffers.key, key))) return false;
+        p = skipSpace(p, end);
+        if (p == end || *p != ':') return false;
+        p = skipSpace(p + 1, end);
+        if (p == end) return false;
         
-        size_t source_start = line.find("\"source\":\"") + 10;
-        size_t source_end = line.find("\"", source_start);
-        if (source_start != std::string::npos && source_end != std::string::npos) {
-            doc.source = line.substr(source_start, source_end - source_start);
+        std::string_view* field = nullptr;
+        std::string* buffer = nullptr;
+        if (key == "url") {
+            field = &doc.url;
+            buffer = &buffers.url;
+        } else if (key == "html_content") {
+            field = &doc.html_content;
+            buffer = &buffers.html_content;
+        } else if (key == "source") {
+            field = &doc.source;
+            buffer = &buffers.source;
         }
         
-        if (!doc.url.empty() && !doc.html_content.empty()) {
-            documents.push_back(doc);
-            count++;
-            
-            if (count % 1000 == 0) {
-                std::cout << "Loaded " << count << " documents" << std::endl;
-            }
+        if (field && *p == '"') {
+            p = parseString(p, end, *buffer, *field);
+        } else {
+            p = skipValue(p, end);
         }
+        if (!p) return false;
+        
+        p = skipSpace(p, end);
+        if (p == end) return false;
+        if (*p == '}') break;
+        if (*p != ',') return false;
+        p = skipSpace(p + 1, end);
     }
     
-    std::cout << "Total loaded: " << documents.size() << " documents" << std::endl;
-    return documents;
+    return !doc.url.empty() && !doc.html_content.empty();
 }
 
-std::string JSONReader::decodeEntities(const std::string& text) {
-    std::string result = text;
-    
-    struct Entity {
-        std::string encoded;
-        std::string decoded;
-    };
+}
+
+bool JSONReader::open(const std::string& filename) {
+    // An empty file holds no documents, and there is nothing to map.
+    struct stat info;
+    if (stat(filename.c_str(), &info) == 0 && S_ISREG(info.st_mode) && info.st_size == 0) {
+        file.close();
+        return true;
+    }
+    if (!file.open(filename)) {
+        std::cerr << "Error: Cannot open file " << filename << std::endl;
+        return false;
+    }
+    file.adviseSequential();
+    return true;
+}
+
+std::string_view JSONReader::contents() const {
+    return std::string_view(file.begin(), file.size());
+}
+
+JsonLinesSource::JsonLinesSource(const JSONReader& reader) : reader(reader), offset(0) {}
+
+bool JsonLinesSource::read(RawBatch& batch, size_t batch_bytes) {
+    std::string_view text = reader.contents();
+    if (offset >= text.size()) return false;
     
-    std::vector<Entity> entities = {
-        {"&nbsp;", " "},
-        {"&amp;", "&"},
-        {"&lt;", "<"},
-        {"&gt;", ">"},
-        {"&quot;", "\""},
-        {"&#39;", "'"},
-        {"&mdash;", "—"},
-        {"&ndash;", "–"},
-        {"\\n", " "},
-        {"\\t", " "},
-        {"\\r", " "}
-    };
+    size_t end = text.find('\n', std::min(text.size(), offset + batch_bytes));
+    end = end == std::string_view::npos ? text.size() : end + 1;
     
-    for (const auto& entity : entities) {
-        size_t pos = 0;
-        while ((pos = result.find(entity.encoded, pos)) != std::string::npos) {
-            result.replace(pos, entity.encoded.length(), entity.decoded);
-            pos += entity.decoded.length();
-        }
+    // Touch every page so that the reads happen here rather than in the
+    // workers.
+    volatile char sink = 0;
+    for (size_t pos = offset; pos < end; pos += PAGE_SIZE) {
+        sink = sink + text[pos];
     }
     
-    return result;
+    batch.lines = text.substr(offset, end - offset);
+    offset = end;
+    return true;
 }
 
-std::string JSONReader::stripHTML(const std::string& html) {
-    std::string result;
-    bool in_tag = false;
-    bool in_script = false;
-    bool in_style = false;
+size_t JSONReader::forEachInRange(std::string_view range,
+                                  const std::function<void(const DocumentView&)>& callback) {
+    FieldBuffers buffers;
+    DocumentView doc;
+    size_t count = 0;
     
-    for (size_t i = 0; i < html.length(); ++i) {
-        if (html[i] == '<') {
-            in_tag = true;
-            
-            if (i + 6 < html.length() && html.substr(i, 7) == "<script") {
-                in_script = true;
-            } else if (i + 5 < html.length() && html.substr(i, 6) == "<style") {
-                in_style = true;
-            }
-        } else if (html[i] == '>') {
-            in_tag = false;
-            
-            if (i >= 8 && html.substr(i - 8, 9) == "</script>") {
-                in_script = false;
-            } else if (i >= 7 && html.substr(i - 7, 8) == "</style>") {
-                in_style = false;
-            }
-            
-            result += " ";
-        } else if (!in_tag && !in_script && !in_style) {
-            result += html[i];
+    const char* p = range.data();
+    const char* end = p + range.size();
+    while (p < end) {
+        const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!line_end) line_end = end;
+        
+        if (parseRecord(std::string_view(p, line_end - p), doc, buffers)) {
+            callback(doc);
+            count++;
         }
+        p = line_end + 1;
     }
     
-    return decodeEntities(result);
-}
\ No newline at end of file
+    return count;
+}
@@ -1,20 +1,43 @@
 #ifndef JSON_READER_H
 #define JSON_READER_H
 
+#include <cstddef>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "document_source.h"
+#include "mapped_file.h"
 
-struct DocumentData {
-    std::string url;
-    std::string html_content;
-    std::string source;
+// Reads documents from a JSON lines file without loading it: the file is
+// memory-mapped, records are split at newlines, each object is walked in
+// place and string values are copied only when they contain escapes.
+// Memory use therefore does not grow with the corpus.
+class JSONReader {
+private:
+    MappedFile file;
+
+public:
+    bool open(const std::string& filename);
+    std::string_view contents() const;
+
+    // Calls callback for every record in range that has a url and HTML
+    // content and returns their number. The range must start at a line.
+    static size_t forEachInRange(std::string_view range,
+                                 const std::function<void(const DocumentView&)>& callback);
 };
 
-class JSONReader {
+// Hands the file of a JSONReader to an IngestPipeline in batches of whole
+// lines. The pages of each batch are faulted in on the read thread, so
+// disk reads overlap with the workers' parsing.
+class JsonLinesSource : public DocumentSource {
+private:
+    const JSONReader& reader;
+    size_t offset;
+    
 public:
-    static std::vector<DocumentData> readFromFile(const std::string& filename);
-    static std::string stripHTML(const std::string& html);
-    static std::string decodeEntities(const std::string& text);
+    explicit JsonLinesSource(const JSONReader& reader);
+    bool read(RawBatch& batch, size_t batch_bytes) override;
 };
 
-#endif
\ No newline at end of file
+#endif
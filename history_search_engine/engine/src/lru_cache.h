@@ -0,0 +1,108 @@
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t invalidations = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t capacity = 0;
+};
+
+// Least recently used cache bounded by the bytes its entries report. All
+// entries belong to one generation of the data they were computed from;
+// validate() with a different generation drops them at once.
+template<typename V>
+class LruCache {
+private:
+    struct Entry {
+        std::string key;
+        V value;
+        size_t bytes;
+    };
+
+    // Most recently used first. Map keys point into the list nodes, which
+    // never move.
+    std::list<Entry> entries;
+    std::unordered_map<std::string_view, typename std::list<Entry>::iterator> lookup;
+    uint64_t generation;
+    CacheStats counters;
+
+    void evict(size_t needed) {
+        while (!entries.empty() && counters.bytes + needed > counters.capacity) {
+            const Entry& last = entries.back();
+            counters.bytes -= last.bytes;
+            lookup.erase(last.key);
+            entries.pop_back();
+            counters.evictions++;
+        }
+    }
+
+public:
+    explicit LruCache(size_t capacity_bytes) : generation(0) {
+        counters.capacity = capacity_bytes;
+    }
+
+    void validate(uint64_t current) {
+        if (current == generation) return;
+        if (!entries.empty()) counters.invalidations++;
+        clear();
+        generation = current;
+    }
+
+    bool get(std::string_view key, V& value) {
+        auto it = lookup.find(key);
+        if (it == lookup.end()) {
+            counters.misses++;
+            return false;
+        }
+        counters.hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        value = it->second->value;
+        return true;
+    }
+
+    // `bytes` is the caller's estimate of the entry's footprint, key
+    // included. Entries larger than the whole cache are not stored.
+    void put(std::string key, V value, size_t bytes) {
+        if (bytes > counters.capacity) return;
+
+        auto it = lookup.find(key);
+        if (it != lookup.end()) {
+            // The map key points into the node; drop it before the node.
+            auto node = it->second;
+            counters.bytes -= node->bytes;
+            lookup.erase(it);
+            entries.erase(node);
+        }
+
+        evict(bytes);
+        entries.push_front({std::move(key), std::move(value), bytes});
+        lookup.emplace(entries.front().key, entries.begin());
+        counters.bytes += bytes;
+    }
+
+    void clear() {
+        lookup.clear();
+        entries.clear();
+        counters.bytes = 0;
+    }
+
+    CacheStats stats() const {
+        CacheStats result = counters;
+        result.entries = entries.size();
+        return result;
+    }
+};
+
+#endif
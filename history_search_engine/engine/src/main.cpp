@@ -4,59 +4,282 @@
 #include "boolean_search.h"
 #include "zipf_analyzer.h"
 #include "json_reader.h"
+#include "index_builder.h"
+#include "segmented_index.h"
+#ifdef WITH_MONGO
+#include "mongo_reader.h"
+#endif
 #include <iostream>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
 
-int main() {
+// Newest crawled_at pulled from MongoDB into the index in the output dir.
+static const char* CHECKPOINT_FILE = "/mongo.checkpoint";
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --input FILE    documents in JSON lines (default: /app/data/documents.json)\n"
+              << "  --output DIR    directory for index and Zipf CSV (default: /app/output)\n"
+              << "  --threads N     number of tokenize/stem workers (default: 1)\n"
+              << "  --memory-budget MB\n"
+              << "                  spill sorted runs to disk when postings exceed MB\n"
+              << "                  and merge them at the end\n"
+              << "  --temp-dir DIR  directory for spilled runs (default: output dir)\n"
+              << "  --positions     store word positions for phrase and NEAR queries\n"
+              << "  --update        add the input as a new segment of the index in the\n"
+              << "                  output dir, replacing older copies of its URLs\n"
+              << "  --delete FILE   remove the URLs listed in FILE (one per line) from\n"
+              << "                  the index in the output dir\n"
+              << "  --mongo URI     read documents from MongoDB instead of --input; with\n"
+              << "                  --update, only those crawled since the last pull\n"
+              << "  --mongo-db NAME database name (default: history_search)\n"
+              << "  --mongo-collection NAME\n"
+              << "                  collection name (default: documents)\n"
+              << "  --mongo-batch N documents per cursor round trip (default: 100)\n";
+}
+
+// Without a source only deletions are applied.
+static int updateSegments(DocumentSource* source, const std::string& output_dir,
+                          const std::string& delete_file, size_t num_threads,
+                          bool store_positions) {
+    SegmentedIndex segments;
+    if (!segments.open(output_dir)) {
+        return 1;
+    }
+    
+    auto start_time = std::chrono::high_resolution_clock::now();
+    
+    if (source) {
+        InvertedIndex index;
+        ZipfAnalyzer zipf;
+        IndexBuilder builder(num_threads, store_positions);
+        size_t processed = builder.build(*source, index, zipf);
+        if (source->failed()) {
+            std::cerr << "\nERROR: Reading documents failed!" << std::endl;
+            return 1;
+        }
+        if (processed == 0) {
+            std::cout << "No new documents" << std::endl;
+        } else if (!segments.addSegment(index)) {
+            std::cerr << "\nERROR: Failed to add segment!" << std::endl;
+            return 1;
+        } else {
+            std::cout << "Added segment with " << processed << " documents" << std::endl;
+        }
+        if (!source->commit()) {
+            return 1;
+        }
+    }
+    
+    if (!delete_file.empty()) {
+        std::ifstream in(delete_file);
+        if (!in) {
+            std::cerr << "Cannot open file: " << delete_file << std::endl;
+            return 1;
+        }
+        std::vector<std::string> urls;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty()) urls.push_back(line);
+        }
+        std::cout << "Deleted documents: " << segments.remove(urls) << std::endl;
+    }
+    
+    std::cout << "\n💾 Merging segments..." << std::endl;
+    segments.mergePending();
+    
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        end_time - start_time).count();
+    
     std::cout << "\n" << std::string(60, '=') << std::endl;
-    std::cout << "=== HISTORY SEARCH ENGINE ===" << std::endl;
+    std::cout << "=== INDEX STATISTICS ===" << std::endl;
     std::cout << std::string(60, '=') << std::endl;
+    std::cout << "Segments: " << segments.getSegmentCount() << std::endl;
+    std::cout << "Live documents: " << segments.getLiveDocuments() << std::endl;
+    std::cout << "Deleted documents awaiting merge: " << segments.getDeletedDocuments() << std::endl;
+    std::cout << "Processing time: " << duration / 1000.0 << " seconds" << std::endl;
+    
+    std::cout << "\n✅ Update complete!" << std::endl;
     
-    std::cout << "\nReading documents from: /app/data/documents.json" << std::endl;
+    return 0;
+}
+
+static int buildWithMemoryBudget(DocumentSource& source, const std::string& output_dir,
+                                 const std::string& temp_dir, size_t memory_budget_mb,
+                                 size_t num_threads, bool store_positions) {
+    std::cout << "Memory budget for postings: " << memory_budget_mb << " MB" << std::endl;
     
-    auto documents = JSONReader::readFromFile("/app/data/documents.json");
+    SpimiIndexer spimi(memory_budget_mb * 1024 * 1024, temp_dir);
+    ZipfAnalyzer zipf;
+    IndexBuilder builder(num_threads, store_positions);
     
-    if (documents.empty()) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    
+    size_t processed = builder.buildStreaming(source, spimi, zipf);
+    if (spimi.failed()) {
+        std::cerr << "\nERROR: Spilling a run failed!" << std::endl;
+        return 1;
+    }
+    if (source.failed()) {
+        std::cerr << "\nERROR: Reading documents failed!" << std::endl;
+        return 1;
+    }
+    if (processed == 0) {
         std::cerr << "\nERROR: No documents found!" << std::endl;
         return 1;
     }
     
-    std::cout << "\nSuccessfully loaded " << documents.size() << " documents\n" << std::endl;
+    std::cout << "\n💾 Merging runs..." << std::endl;
+    SegmentedIndex::clear(output_dir);
+    if (!spimi.finish(output_dir + "/inverted_index.bin")) {
+        std::cerr << "\nERROR: Failed to write index!" << std::endl;
+        return 1;
+    }
+    std::remove((output_dir + CHECKPOINT_FILE).c_str());
+    if (!source.commit()) {
+        return 1;
+    }
     
-    Tokenizer tokenizer;
-    Stemmer stemmer;
-    InvertedIndex index;
-    ZipfAnalyzer zipf;
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        end_time - start_time).count();
     
-    auto start_time = std::chrono::high_resolution_clock::now();
+    std::cout << "\n" << std::string(60, '=') << std::endl;
+    std::cout << "=== INDEX STATISTICS ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    std::cout << "Vocabulary size: " << spimi.getVocabularySize() << std::endl;
+    std::cout << "Indexed documents: " << processed << std::endl;
+    std::cout << "Spilled runs: " << spimi.getRunCount() << std::endl;
+    std::cout << "Processing time: " << duration / 1000.0 << " seconds" << std::endl;
+    if (duration > 0) {
+        std::cout << "Throughput: " << processed * 1000.0 / duration 
+                  << " docs/sec" << std::endl;
+    }
     
-    std::cout << "Processing documents..." << std::endl;
+    zipf.saveToCSV(output_dir + "/zipf_analysis.csv");
+    zipf.printStatistics();
     
-    for (size_t i = 0; i < documents.size(); ++i) {
-        const auto& doc = documents[i];
-        
-        std::string clean_text = JSONReader::stripHTML(doc.html_content);
-        auto tokens = tokenizer.tokenize(clean_text);
+    std::cout << "\n✅ Processing complete!" << std::endl;
+    
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string input_file = "/app/data/documents.json";
+    std::string output_dir = "/app/output";
+    std::string temp_dir;
+    std::string delete_file;
+    std::string mongo_uri;
+    std::string mongo_db = "history_search";
+    std::string mongo_collection = "documents";
+    int mongo_batch = 100;
+    size_t num_threads = 1;
+    size_t memory_budget_mb = 0;
+    bool store_positions = false;
+    bool update = false;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
         
-        std::vector<Token> stemmed_tokens;
-        for (auto& token : tokens) {
-            std::string stem = stemmer.stem(token.text);
-            zipf.addTerm(stem);
-            
-            Token stemmed_token;
-            stemmed_token.text = stem;
-            stemmed_token.position = token.position;
-            stemmed_tokens.push_back(stemmed_token);
+        if (arg == "--input" && i + 1 < argc) {
+            input_file = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            output_dir = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            num_threads = std::strtoul(argv[++i], nullptr, 10);
+            if (num_threads == 0) num_threads = 1;
+        } else if (arg == "--memory-budget" && i + 1 < argc) {
+            memory_budget_mb = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--temp-dir" && i + 1 < argc) {
+            temp_dir = argv[++i];
+        } else if (arg == "--positions") {
+            store_positions = true;
+        } else if (arg == "--update") {
+            update = true;
+        } else if (arg == "--delete" && i + 1 < argc) {
+            delete_file = argv[++i];
+        } else if (arg == "--mongo" && i + 1 < argc) {
+            mongo_uri = argv[++i];
+        } else if (arg == "--mongo-db" && i + 1 < argc) {
+            mongo_db = argv[++i];
+        } else if (arg == "--mongo-collection" && i + 1 < argc) {
+            mongo_collection = argv[++i];
+        } else if (arg == "--mongo-batch" && i + 1 < argc) {
+            mongo_batch = std::atoi(argv[++i]);
+            if (mongo_batch <= 0) mongo_batch = 100;
+        } else {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : 1;
         }
-        
-        index.addDocument(doc.url, stemmed_tokens);
-        
-        if ((i + 1) % 500 == 0) {
-            std::cout << "✓ Processed " << (i + 1) << "/" << documents.size() 
-                      << " documents" << std::endl;
+    }
+    
+    std::cout << "\n" << std::string(60, '=') << std::endl;
+    std::cout << "=== HISTORY SEARCH ENGINE ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    if (temp_dir.empty()) {
+        temp_dir = output_dir;
+    }
+    
+    // --delete alone only removes documents.
+    JSONReader reader;
+    std::unique_ptr<DocumentSource> source;
+    if (update || delete_file.empty()) {
+        if (!mongo_uri.empty()) {
+#ifdef WITH_MONGO
+            auto mongo = std::make_unique<MongoReader>();
+            if (!mongo->open(mongo_uri, mongo_db, mongo_collection, output_dir + CHECKPOINT_FILE,
+                             update, mongo_batch)) {
+                return 1;
+            }
+            source = std::move(mongo);
+#else
+            std::cerr << "ERROR: built without MongoDB support" << std::endl;
+            return 1;
+#endif
+        } else {
+            std::cout << "\nReading documents from: " << input_file << std::endl;
+            if (!reader.open(input_file)) {
+                return 1;
+            }
+            source = std::make_unique<JsonLinesSource>(reader);
         }
     }
     
+    if (update || !delete_file.empty()) {
+        return updateSegments(source.get(), output_dir, delete_file, num_threads,
+                              store_positions);
+    }
+    
+    if (memory_budget_mb > 0) {
+        return buildWithMemoryBudget(*source, output_dir, temp_dir, memory_budget_mb,
+                                     num_threads, store_positions);
+    }
+    
+    InvertedIndex index;
+    ZipfAnalyzer zipf;
+    IndexBuilder builder(num_threads, store_positions);
+    
+    auto start_time = std::chrono::high_resolution_clock::now();
+    
+    std::cout << "Processing documents with " << num_threads << " thread(s)..." << std::endl;
+    
+    size_t processed = builder.build(*source, index, zipf);
+    if (source->failed()) {
+        std::cerr << "\nERROR: Reading documents failed!" << std::endl;
+        return 1;
+    }
+    if (processed == 0) {
+        std::cerr << "\nERROR: No documents found!" << std::endl;
+        return 1;
+    }
+    
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
         end_time - start_time).count();
@@ -65,12 +288,23 @@ int main() {
     std::cout << "=== INDEX STATISTICS ===" << std::endl;
     std::cout << std::string(60, '=') << std::endl;
     std::cout << "Vocabulary size: " << index.getVocabularySize() << std::endl;
-    std::cout << "Indexed documents: " << documents.size() << std::endl;
+    std::cout << "Indexed documents: " << processed << std::endl;
     std::cout << "Processing time: " << duration / 1000.0 << " seconds" << std::endl;
+    if (duration > 0) {
+        std::cout << "Throughput: " << processed * 1000.0 / duration 
+                  << " docs/sec" << std::endl;
+    }
     
     std::cout << "\n💾 Saving results..." << std::endl;
-    index.saveToFile("/app/output/inverted_index.bin");
-    zipf.saveToCSV("/app/output/zipf_analysis.csv");
+    SegmentedIndex::clear(output_dir);
+    if (!index.saveToFile(output_dir + "/inverted_index.bin")) {
+        return 1;
+    }
+    std::remove((output_dir + CHECKPOINT_FILE).c_str());
+    if (!source->commit()) {
+        return 1;
+    }
+    zipf.saveToCSV(output_dir + "/zipf_analysis.csv");
     zipf.printStatistics();
     
     std::cout << "\n✅ Processing complete!" << std::endl;
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only shared mapping of a whole file. Pages are loaded on first access
+// and shared through the page cache by every process mapping the same file.
+class MappedFile {
+private:
+    const char* data;
+    size_t length;
+    
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    bool open(const std::string& filename);
+    void close();
+    // Hints that the mapping will be read front to back, so the kernel
+    // reads ahead aggressively.
+    void adviseSequential() const;
+    
+    bool isOpen() const { return data != nullptr; }
+    const char* begin() const { return data; }
+    size_t size() const { return length; }
+};
+
+#endif
@@ -1,127 +1,142 @@
 #include "mongo_reader.h"
+#include <cstdio>
+#include <fstream>
 #include <iostream>
-#include <mongocxx/client.hpp>
+#include <string_view>
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/types.hpp>
 #include <mongocxx/instance.hpp>
-#include <bsoncxx/json.hpp>
-
-std::vector<DocumentData> MongoReader::readFromMongoDB(
-    const std::string& uri,
-    const std::string& db_name,
-    const std::string& collection_name) {
-    
-    std::vector<DocumentData> documents;
-    
+#include <mongocxx/options/find.hpp>
+#include <mongocxx/uri.hpp>
+
+using bsoncxx::builder::basic::kvp;
+using bsoncxx::builder::basic::make_document;
+
+namespace {
+
+std::string_view stringField(const bsoncxx::document::view& doc, const char* key) {
+    auto element = doc[key];
+    if (!element || element.type() != bsoncxx::type::k_utf8) return {};
+    auto value = element.get_utf8().value;
+    return std::string_view(value.data(), value.size());
+}
+
+// The crawler stores crawled_at as Unix seconds.
+bool timestampField(const bsoncxx::document::view& doc, const char* key, int64_t& value) {
+    auto element = doc[key];
+    if (!element) return false;
+    if (element.type() == bsoncxx::type::k_int64) {
+        value = element.get_int64().value;
+        return true;
+    }
+    if (element.type() == bsoncxx::type::k_int32) {
+        value = element.get_int32().value;
+        return true;
+    }
+    return false;
+}
+
+}
+
+MongoReader::MongoReader()
+    : has_checkpoint(false), newest_crawled_at(0), documents_read(0), error(false) {}
+
+bool MongoReader::loadCheckpoint(const std::string& filename, int64_t& crawled_at) {
+    std::ifstream in(filename);
+    std::string key;
+    return in >> key >> crawled_at && key == "crawled_at";
+}
+
+bool MongoReader::open(const std::string& uri, const std::string& db_name,
+                       const std::string& collection_name, const std::string& checkpoint,
+                       bool resume, int32_t cursor_batch) {
+    checkpoint_file = checkpoint;
+    has_checkpoint = resume && loadCheckpoint(checkpoint_file, newest_crawled_at);
+
     try {
         static mongocxx::instance instance{};
-        
-        mongocxx::client client{mongocxx::uri{uri}};
-        auto db = client[db_name];
-        auto collection = db[collection_name];
-        
-        std::cout << "Connected to MongoDB: " << uri << std::endl;
-        
-        int64_t total = collection.count_documents({});
-        std::cout << "Total documents in collection: " << total << std::endl;
-        
-        auto cursor = collection.find({});
-        
-        int count = 0;
-        for (auto&& doc : cursor) {
-            DocumentData data;
-            
-            auto url_elem = doc["url"];
-            if (url_elem && url_elem.type() == bsoncxx::type::k_utf8) {
-                data.url = std::string(url_elem.get_utf8().value);
-            }
-            
-            auto html_elem = doc["html_content"];
-            if (html_elem && html_elem.type() == bsoncxx::type::k_utf8) {
-                data.html_content = std::string(html_elem.get_utf8().value);
-            }
-            
-            auto source_elem = doc["source"];
-            if (source_elem && source_elem.type() == bsoncxx::type::k_utf8) {
-                data.source = std::string(source_elem.get_utf8().value);
-            }
-            
-            if (!data.url.empty() && !data.html_content.empty()) {
-                documents.push_back(data);
-                count++;
-                
-                if (count % 1000 == 0) {
-                    std::cout << "Loaded " << count << "/" << total << " documents" << std::endl;
-                }
-            }
+
+        client = mongocxx::client{mongocxx::uri{uri}};
+        auto database = client[db_name];
+        auto collection = database[collection_name];
+
+        mongocxx::options::find options;
+        options.batch_size(cursor_batch);
+        options.projection(make_document(kvp("_id", 0), kvp("url", 1), kvp("html_content", 1),
+                                         kvp("source", 1), kvp("crawled_at", 1)));
+
+        auto filter = make_document();
+        if (has_checkpoint) {
+            int64_t since = newest_crawled_at - CHECKPOINT_OVERLAP;
+            filter = make_document(kvp("crawled_at", make_document(kvp("$gte", since))));
         }
-        
-        std::cout << "Successfully loaded " << documents.size() << " documents from MongoDB" << std::endl;
-        
+
+        cursor.emplace(collection.find(filter.view(), options));
+        position.emplace(cursor->begin());
     } catch (const std::exception& e) {
         std::cerr << "MongoDB error: " << e.what() << std::endl;
+        return false;
+    }
+
+    std::cout << "Reading documents from MongoDB: " << db_name << "." << collection_name;
+    if (has_checkpoint) {
+        std::cout << " crawled since " << newest_crawled_at - CHECKPOINT_OVERLAP;
     }
-    
-    return documents;
+    std::cout << std::endl;
+    return true;
 }
 
-std::string MongoReader::decodeEntities(const std::string& text) {
-    std::string result = text;
-    
-    struct Entity {
-        std::string encoded;
-        std::string decoded;
-    };
-    
-    std::vector<Entity> entities = {
-        {"&nbsp;", " "},
-        {"&amp;", "&"},
-        {"&lt;", "<"},
-        {"&gt;", ">"},
-        {"&quot;", "\""},
-        {"&#39;", "'"},
-        {"&mdash;", "—"},
-        {"&ndash;", "–"}
-    };
-    
-    for (const auto& entity : entities) {
-        size_t pos = 0;
-        while ((pos = result.find(entity.encoded, pos)) != std::string::npos) {
-            result.replace(pos, entity.encoded.length(), entity.decoded);
-            pos += entity.decoded.length();
+bool MongoReader::read(RawBatch& batch, size_t batch_bytes) {
+    if (!position || error) return false;
+
+    try {
+        // Each document is copied out before the iterator moves on, since
+        // the view points into the cursor's current reply.
+        for (; *position != cursor->end(); ++*position) {
+            if (batch.bytes() >= batch_bytes) return true;
+
+            const bsoncxx::document::view& doc = **position;
+            std::string_view url = stringField(doc, "url");
+            std::string_view html_content = stringField(doc, "html_content");
+            if (url.empty() || html_content.empty()) continue;
+
+            batch.addDocument(url, html_content, stringField(doc, "source"));
+            documents_read++;
+
+            int64_t crawled_at;
+            if (timestampField(doc, "crawled_at", crawled_at) &&
+                (!has_checkpoint || crawled_at > newest_crawled_at)) {
+                newest_crawled_at = crawled_at;
+                has_checkpoint = true;
+            }
         }
+    } catch (const std::exception& e) {
+        std::cerr << "MongoDB error: " << e.what() << std::endl;
+        error = true;
+        return false;
     }
-    
-    return result;
+
+    return !batch.documents.empty();
 }
 
-std::string MongoReader::stripHTML(const std::string& html) {
-    std::string result;
-    bool in_tag = false;
-    bool in_script = false;
-    bool in_style = false;
-    
-    for (size_t i = 0; i < html.length(); ++i) {
-        if (html[i] == '<') {
-            in_tag = true;
-            
-            if (i + 6 < html.length() && html.substr(i, 7) == "<script") {
-                in_script = true;
-            } else if (i + 5 < html.length() && html.substr(i, 6) == "<style") {
-                in_style = true;
-            }
-        } else if (html[i] == '>') {
-            in_tag = false;
-            
-            if (i >= 8 && html.substr(i - 8, 9) == "</script>") {
-                in_script = false;
-            } else if (i >= 7 && html.substr(i - 7, 8) == "</style>") {
-                in_style = false;
-            }
-            
-            result += " ";
-        } else if (!in_tag && !in_script && !in_style) {
-            result += html[i];
+bool MongoReader::commit() {
+    if (error || !has_checkpoint || checkpoint_file.empty()) return !error;
+
+    std::string temp = checkpoint_file + ".tmp";
+    {
+        std::ofstream out(temp);
+        out << "crawled_at " << newest_crawled_at << '\n';
+        out.flush();
+        if (!out) {
+            std::cerr << "Failed to write checkpoint: " << temp << std::endl;
+            return false;
         }
     }
-    
-    return decodeEntities(result);
-}
\ No newline at end of file
+    if (std::rename(temp.c_str(), checkpoint_file.c_str()) != 0) {
+        std::cerr << "Failed to replace checkpoint: " << checkpoint_file << std::endl;
+        return false;
+    }
+    return true;
+}
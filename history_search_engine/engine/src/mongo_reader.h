@@ -1,24 +1,55 @@
 #ifndef MONGO_READER_H
 #define MONGO_READER_H
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <string>
-#include <vector>
+#include <mongocxx/client.hpp>
+#include <mongocxx/cursor.hpp>
+#include "document_source.h"
 
-struct DocumentData {
-    std::string url;
-    std::string html_content;
-    std::string source;
-};
+// Streams the crawler's documents out of MongoDB into an IngestPipeline.
+// A single cursor walks the collection, fetching cursor_batch documents per
+// round trip and only the fields the index needs, so the collection is
+// never loaded or counted up front.
+//
+// The crawler replaces a re-crawled page in place and keeps its _id, so
+// new content is found by crawled_at rather than by _id. A pull can resume
+// from a checkpoint file holding the newest crawled_at indexed so far. It
+// then fetches the documents crawled since, starting CHECKPOINT_OVERLAP
+// seconds earlier to catch pages that slow crawler workers saved late. A
+// page seen twice replaces its own earlier copy in a segmented index.
+class MongoReader : public DocumentSource {
+private:
+    mongocxx::client client;
+    std::optional<mongocxx::cursor> cursor;
+    std::optional<mongocxx::cursor::iterator> position;
+    std::string checkpoint_file;
+    bool has_checkpoint;
+    int64_t newest_crawled_at;
+    size_t documents_read;
+    bool error;
 
-class MongoReader {
 public:
-    static std::vector<DocumentData> readFromMongoDB(
-        const std::string& uri,
-        const std::string& db_name,
-        const std::string& collection_name
-    );
-    static std::string stripHTML(const std::string& html);
-    static std::string decodeEntities(const std::string& text);
+    static const int32_t DEFAULT_CURSOR_BATCH = 100;
+    static const int64_t CHECKPOINT_OVERLAP = 300;
+
+    MongoReader();
+
+    // Opens a cursor over the collection. With resume set, only documents
+    // crawled since the checkpoint in checkpoint_file are pulled, or all of
+    // them if there is none yet; commit() advances the checkpoint.
+    bool open(const std::string& uri, const std::string& db_name,
+              const std::string& collection_name, const std::string& checkpoint_file,
+              bool resume, int32_t cursor_batch = DEFAULT_CURSOR_BATCH);
+    bool read(RawBatch& batch, size_t batch_bytes) override;
+    bool failed() const override { return error; }
+    bool commit() override;
+
+    size_t getDocumentsRead() const { return documents_read; }
+
+    static bool loadCheckpoint(const std::string& filename, int64_t& crawled_at);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,69 @@
+#include "position_list.h"
+#include "posting_codec.h"
+
+const uint8_t* PositionView::skip(const uint8_t* p, uint32_t freq) {
+    while (freq > 0) {
+        freq -= *p++ < 0x80;
+    }
+    return p;
+}
+
+const uint8_t* PositionView::decode(const uint8_t* p, uint32_t freq, uint32_t* positions) {
+    uint32_t position = 0;
+    for (uint32_t i = 0; i < freq; ++i) {
+        position += PostingCodec::readVarint(p);
+        positions[i] = position;
+    }
+    return p;
+}
+
+void PositionList::add(uint32_t index, const uint32_t* positions, size_t n) {
+    if (index % PostingCodec::BLOCK_SIZE == 0) {
+        block_offsets.push_back(static_cast<uint32_t>(data.size()));
+    }
+    
+    uint32_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        PostingCodec::writeVarint(data, positions[i] - prev);
+        prev = positions[i];
+    }
+}
+
+PositionView PositionList::view() const {
+    PositionView v;
+    v.block_offsets = block_offsets.data();
+    v.data = data.data();
+    v.num_blocks = static_cast<uint32_t>(block_offsets.size());
+    v.data_size = static_cast<uint32_t>(data.size());
+    return v;
+}
+
+size_t PositionList::memoryUsage() const {
+    return block_offsets.capacity() * sizeof(uint32_t) + data.capacity();
+}
+
+void PositionList::save(std::ostream& out) const {
+    uint32_t num_blocks = static_cast<uint32_t>(block_offsets.size());
+    uint32_t data_size = static_cast<uint32_t>(data.size());
+    
+    out.write(reinterpret_cast<const char*>(&num_blocks), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(block_offsets.data()), num_blocks * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&data_size), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(data.data()), data_size);
+}
+
+bool PositionList::load(std::istream& in) {
+    uint32_t num_blocks = 0, data_size = 0;
+    
+    in.read(reinterpret_cast<char*>(&num_blocks), sizeof(uint32_t));
+    if (!in) return false;
+    block_offsets.resize(num_blocks);
+    in.read(reinterpret_cast<char*>(block_offsets.data()), num_blocks * sizeof(uint32_t));
+    
+    in.read(reinterpret_cast<char*>(&data_size), sizeof(uint32_t));
+    if (!in) return false;
+    data.resize(data_size);
+    in.read(reinterpret_cast<char*>(data.data()), data_size);
+    
+    return static_cast<bool>(in);
+}
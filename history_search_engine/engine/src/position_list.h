@@ -0,0 +1,46 @@
+#ifndef POSITION_LIST_H
+#define POSITION_LIST_H
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Read-only view of a term's position lists (see PositionList).
+struct PositionView {
+    const uint32_t* block_offsets = nullptr;
+    const uint8_t* data = nullptr;
+    uint32_t num_blocks = 0;
+    uint32_t data_size = 0;
+    
+    bool empty() const { return num_blocks == 0; }
+    // Positions of the first posting of posting block `block`.
+    const uint8_t* blockData(size_t block) const { return data + block_offsets[block]; }
+    
+    // Skips the positions of one posting with `freq` occurrences.
+    static const uint8_t* skip(const uint8_t* p, uint32_t freq);
+    static const uint8_t* decode(const uint8_t* p, uint32_t freq, uint32_t* positions);
+};
+
+// Word positions of every posting of a term, stored next to its PostingList.
+// A posting's positions are varbyte deltas (the first one from 0); there are
+// exactly freq of them, so a reader finds a posting by skipping the
+// positions of the postings before it. block_offsets marks where every
+// block of BLOCK_SIZE postings starts, matching the PostingList blocks.
+class PositionList {
+private:
+    std::vector<uint32_t> block_offsets;
+    std::vector<uint8_t> data;
+    
+public:
+    // Adds the positions of posting number `index` (ascending, n of them).
+    void add(uint32_t index, const uint32_t* positions, size_t n);
+    
+    bool empty() const { return block_offsets.empty(); }
+    PositionView view() const;
+    
+    size_t memoryUsage() const;
+    void save(std::ostream& out) const;
+    bool load(std::istream& in);
+};
+
+#endif
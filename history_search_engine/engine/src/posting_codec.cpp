@@ -0,0 +1,125 @@
+#include "posting_codec.h"
+#include <array>
+#include <cstring>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+template<uint32_t B>
+void unpackBits(const uint32_t* in, uint32_t* out) {
+    if constexpr (B == 0) {
+        std::memset(out, 0, PostingCodec::BLOCK_SIZE * sizeof(uint32_t));
+        return;
+    }
+
+    const uint32_t mask = B == 32 ? 0xFFFFFFFFu : (1u << (B % 32)) - 1;
+
+#ifdef __SSE2__
+    const __m128i* src = reinterpret_cast<const __m128i*>(in);
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+    const __m128i vmask = _mm_set1_epi32(static_cast<int>(mask));
+
+#pragma GCC unroll 32
+    for (uint32_t row = 0; row < 32; ++row) {
+        const uint32_t pos = row * B;
+        const uint32_t word = pos / 32;
+        const uint32_t shift = pos % 32;
+
+        __m128i value = _mm_srli_epi32(_mm_loadu_si128(src + word), shift);
+        if (shift + B > 32) {
+            value = _mm_or_si128(value,
+                _mm_slli_epi32(_mm_loadu_si128(src + word + 1), 32 - shift));
+        }
+        _mm_storeu_si128(dst + row, _mm_and_si128(value, vmask));
+    }
+#else
+    for (uint32_t row = 0; row < 32; ++row) {
+        const uint32_t pos = row * B;
+        const uint32_t word = pos / 32;
+        const uint32_t shift = pos % 32;
+
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            uint32_t value = in[4 * word + lane] >> shift;
+            if (shift + B > 32) {
+                value |= in[4 * (word + 1) + lane] << (32 - shift);
+            }
+            out[4 * row + lane] = value & mask;
+        }
+    }
+#endif
+}
+
+using UnpackFn = void (*)(const uint32_t*, uint32_t*);
+
+template<size_t... Bits>
+constexpr auto makeUnpackTable(std::index_sequence<Bits...>) {
+    return std::array<UnpackFn, sizeof...(Bits)>{{&unpackBits<Bits>...}};
+}
+
+}
+
+uint32_t PostingCodec::maxBits(const uint32_t* values, size_t n) {
+    uint32_t acc = 0;
+    for (size_t i = 0; i < n; ++i) {
+        acc |= values[i];
+    }
+    return acc == 0 ? 0 : 32 - __builtin_clz(acc);
+}
+
+void PostingCodec::pack(const uint32_t* in, uint32_t* out, uint32_t bits) {
+    std::memset(out, 0, packedWords(bits) * sizeof(uint32_t));
+    if (bits == 0) return;
+
+    for (uint32_t row = 0; row < 32; ++row) {
+        const uint32_t pos = row * bits;
+        const uint32_t word = pos / 32;
+        const uint32_t shift = pos % 32;
+
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            uint32_t value = in[4 * row + lane];
+            out[4 * word + lane] |= value << shift;
+            if (shift + bits > 32) {
+                out[4 * (word + 1) + lane] |= value >> (32 - shift);
+            }
+        }
+    }
+}
+
+void PostingCodec::unpack(const uint32_t* in, uint32_t* out, uint32_t bits) {
+    static const auto table = makeUnpackTable(std::make_index_sequence<33>());
+    table[bits](in, out);
+}
+
+void PostingCodec::prefixSum(uint32_t* values, uint32_t base) {
+#ifdef __SSE2__
+    __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+    __m128i* data = reinterpret_cast<__m128i*>(values);
+
+    for (size_t i = 0; i < BLOCK_SIZE / 4; ++i) {
+        __m128i x = _mm_loadu_si128(data + i);
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128(data + i, x);
+        carry = _mm_shuffle_epi32(x, 0xFF);
+    }
+#else
+    uint32_t sum = base;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        sum += values[i];
+        values[i] = sum;
+    }
+#endif
+}
+
+void PostingCodec::writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
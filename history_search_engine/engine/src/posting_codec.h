@@ -0,0 +1,42 @@
+#ifndef POSTING_CODEC_H
+#define POSTING_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Integer codecs for posting lists.
+//
+// Full blocks of BLOCK_SIZE integers are bit-packed in the vertical
+// SIMD-BP128 layout: integer i goes to 32-bit lane i % 4, and each lane packs
+// its 32 integers into `bits` consecutive words, interleaved with the other
+// lanes. A block of width b therefore takes 4 * b words and all four lanes
+// unpack together with SSE2 shifts and masks. Short runs use varbyte.
+class PostingCodec {
+public:
+    static const size_t BLOCK_SIZE = 128;
+
+    static uint32_t maxBits(const uint32_t* values, size_t n);
+    static size_t packedWords(uint32_t bits) { return 4 * bits; }
+    static void pack(const uint32_t* in, uint32_t* out, uint32_t bits);
+    static void unpack(const uint32_t* in, uint32_t* out, uint32_t bits);
+
+    // values[i] = base + values[0] + ... + values[i], over one block.
+    static void prefixSum(uint32_t* values, uint32_t base);
+
+    static void writeVarint(std::vector<uint8_t>& out, uint32_t value);
+    static uint32_t readVarint(const uint8_t*& p) {
+        uint32_t value = *p++;
+        if (value < 0x80) return value;
+        value &= 0x7F;
+        int shift = 7;
+        while (true) {
+            uint32_t byte = *p++;
+            value |= (byte & 0x7F) << shift;
+            if (byte < 0x80) return value;
+            shift += 7;
+        }
+    }
+};
+
+#endif
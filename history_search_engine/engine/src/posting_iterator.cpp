@@ -0,0 +1,120 @@
+#include "posting_iterator.h"
+#include <algorithm>
+
+PostingIterator::PostingIterator(const PostingView& list)
+    : list(list), block(0), pos(0), block_size(0), freqs_decoded(false),
+      positions_ptr(nullptr), positions_index(0) {
+    if (!list.empty()) {
+        loadBlock(0);
+    }
+}
+
+void PostingIterator::loadBlock(size_t b) {
+    block = b;
+    pos = 0;
+    freqs_decoded = false;
+    positions_index = 0;
+    positions_ptr = b < list.positions.num_blocks ? list.positions.blockData(b) : nullptr;
+    
+    if (b < list.numBlocks()) {
+        list.decodeBlockDocIds(b, doc_ids);
+        block_size = PostingCodec::BLOCK_SIZE;
+    } else if (b == list.numBlocks()) {
+        block_size = list.decodeTail(doc_ids, freqs);
+        freqs_decoded = true;
+    } else {
+        block_size = 0;
+    }
+}
+
+void PostingIterator::decodeFreqs() {
+    if (!freqs_decoded) {
+        list.decodeBlockFreqs(block, freqs);
+        freqs_decoded = true;
+    }
+}
+
+uint32_t PostingIterator::freq() {
+    decodeFreqs();
+    return freqs[pos];
+}
+
+void PostingIterator::positions(std::vector<uint32_t>& out) {
+    out.clear();
+    if (atEnd() || !positions_ptr) return;
+    
+    decodeFreqs();
+    while (positions_index < pos) {
+        positions_ptr = PositionView::skip(positions_ptr, freqs[positions_index]);
+        positions_index++;
+    }
+    
+    out.resize(freqs[pos]);
+    PositionView::decode(positions_ptr, freqs[pos], out.data());
+}
+
+uint32_t PostingIterator::next() {
+    if (atEnd()) return END;
+    
+    if (++pos == block_size) {
+        loadBlock(block + 1);
+    }
+    return docId();
+}
+
+uint32_t PostingIterator::nextGEQ(uint32_t target) {
+    if (atEnd() || doc_ids[pos] >= target) return docId();
+    
+    if (doc_ids[block_size - 1] < target) {
+        size_t num_blocks = list.numBlocks();
+        
+        // Gallop over the skip entries, then binary search the last step.
+        size_t lo = block + 1;
+        size_t step = 1;
+        size_t hi = lo;
+        while (hi < num_blocks && list.blockLastDoc(hi) < target) {
+            lo = hi + 1;
+            hi = lo + step;
+            step *= 2;
+        }
+        hi = std::min(hi, num_blocks);
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (list.blockLastDoc(mid) < target) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        
+        loadBlock(lo);
+        if (atEnd() || doc_ids[block_size - 1] < target) {
+            pos = block_size;
+            return END;
+        }
+    }
+    
+    pos = std::lower_bound(doc_ids + pos, doc_ids + block_size, target) - doc_ids;
+    return docId();
+}
+
+double PostingIterator::blockMaxScore(uint32_t target, uint32_t& block_last) const {
+    if (atEnd() || target > list.lastDocId()) {
+        block_last = END;
+        return 0.0;
+    }
+    
+    size_t lo = block;
+    size_t hi = list.numBlocks();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (list.blockLastDoc(mid) < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    
+    block_last = lo < list.numBlocks() ? list.blockLastDoc(lo) : list.lastDocId();
+    return list.blockMaxScore(lo);
+}
@@ -0,0 +1,56 @@
+#ifndef POSTING_ITERATOR_H
+#define POSTING_ITERATOR_H
+
+#include <cstdint>
+#include <vector>
+#include "posting_list.h"
+
+// Forward cursor over compressed postings. Blocks are decoded lazily:
+// nextGEQ() first skips whole blocks using their last doc IDs and only then
+// unpacks the one block that can contain the target. Frequencies of a block
+// are unpacked only if freq() is called, positions only if positions() is.
+class PostingIterator {
+private:
+    PostingView list;
+    size_t block;
+    size_t pos;
+    size_t block_size;
+    bool freqs_decoded;
+    // Start of the positions of posting positions_index in this block.
+    const uint8_t* positions_ptr;
+    size_t positions_index;
+    uint32_t doc_ids[PostingCodec::BLOCK_SIZE];
+    uint32_t freqs[PostingCodec::BLOCK_SIZE];
+    
+    void loadBlock(size_t b);
+    void decodeFreqs();
+    
+public:
+    static const uint32_t END = 0xFFFFFFFFu;
+    
+    explicit PostingIterator(const PostingView& list);
+    
+    uint32_t docId() const { return pos < block_size ? doc_ids[pos] : END; }
+    uint32_t freq();
+    uint32_t size() const { return list.size(); }
+    bool atEnd() const { return pos >= block_size; }
+    bool hasPositions() const { return list.hasPositions(); }
+    // Word positions of the current posting; empty without a positional index.
+    void positions(std::vector<uint32_t>& out);
+    
+    // The not yet consumed part of the current decoded block.
+    const uint32_t* blockDocIds() const { return doc_ids + pos; }
+    size_t blockRemaining() const { return block_size - pos; }
+    uint32_t blockLastDoc() const { return doc_ids[block_size - 1]; }
+    
+    // Upper bound of the scores in the block that holds target (or the next
+    // posting after it), and that block's last doc ID, found from the skip
+    // entries without decoding. Returns 0 and END past the last posting.
+    double blockMaxScore(uint32_t target, uint32_t& block_last) const;
+    
+    uint32_t next();
+    // Moves to the first posting with doc ID >= target and returns it (or END).
+    uint32_t nextGEQ(uint32_t target);
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "posting_list.h"
+
+PostingList::PostingList() : count(0), last_doc(0) {}
+
+void PostingList::add(uint32_t doc_id, int freq, const uint32_t* doc_positions) {
+    if (doc_positions) {
+        positions.add(count, doc_positions, static_cast<size_t>(freq));
+    }
+    
+    uint32_t prev = count == 0 ? 0 : last_doc;
+    PostingCodec::writeVarint(tail, doc_id - prev);
+    PostingCodec::writeVarint(tail, static_cast<uint32_t>(freq - 1));
+    last_doc = doc_id;
+    count++;
+    
+    if (count % PostingCodec::BLOCK_SIZE == 0) {
+        packTail();
+    }
+}
+
+void PostingList::packTail() {
+    uint32_t deltas[PostingCodec::BLOCK_SIZE];
+    uint32_t freqs[PostingCodec::BLOCK_SIZE];
+    
+    const uint8_t* p = tail.data();
+    for (size_t i = 0; i < PostingCodec::BLOCK_SIZE; ++i) {
+        deltas[i] = PostingCodec::readVarint(p);
+        freqs[i] = PostingCodec::readVarint(p);
+    }
+    
+    PostingBlock block;
+    block.last_doc = last_doc;
+    block.offset = static_cast<uint32_t>(packed.size());
+    block.doc_bits = static_cast<uint8_t>(PostingCodec::maxBits(deltas, PostingCodec::BLOCK_SIZE));
+    block.freq_bits = static_cast<uint8_t>(PostingCodec::maxBits(freqs, PostingCodec::BLOCK_SIZE));
+    block.score_bound = 0;
+    
+    size_t doc_words = PostingCodec::packedWords(block.doc_bits);
+    size_t freq_words = PostingCodec::packedWords(block.freq_bits);
+    packed.resize(packed.size() + doc_words + freq_words);
+    PostingCodec::pack(deltas, packed.data() + block.offset, block.doc_bits);
+    PostingCodec::pack(freqs, packed.data() + block.offset + doc_words, block.freq_bits);
+    
+    blocks.push_back(block);
+    tail.clear();
+}
+
+void PostingList::append(const PostingList& other) {
+    std::vector<uint32_t> doc_ids;
+    std::vector<int> freqs;
+    other.decode(doc_ids, freqs);
+    
+    if (other.positions.empty()) {
+        for (size_t i = 0; i < doc_ids.size(); ++i) {
+            add(doc_ids[i], freqs[i]);
+        }
+        return;
+    }
+    
+    std::vector<uint32_t> doc_positions;
+    const uint8_t* p = other.positions.view().data;
+    for (size_t i = 0; i < doc_ids.size(); ++i) {
+        doc_positions.resize(freqs[i]);
+        p = PositionView::decode(p, freqs[i], doc_positions.data());
+        add(doc_ids[i], freqs[i], doc_positions.data());
+    }
+}
+
+PostingView PostingList::view() const {
+    PostingView v;
+    v.blocks = blocks.data();
+    v.packed = packed.data();
+    v.tail = tail.data();
+    v.num_blocks = static_cast<uint32_t>(blocks.size());
+    v.num_words = static_cast<uint32_t>(packed.size());
+    v.tail_size = static_cast<uint32_t>(tail.size());
+    v.count = count;
+    v.last_doc = last_doc;
+    v.positions = positions.view();
+    return v;
+}
+
+void PostingView::decodeBlockDocIds(size_t block, uint32_t* doc_ids) const {
+    const PostingBlock& info = blocks[block];
+    PostingCodec::unpack(packed + info.offset, doc_ids, info.doc_bits);
+    PostingCodec::prefixSum(doc_ids, block == 0 ? 0 : blocks[block - 1].last_doc);
+}
+
+void PostingView::decodeBlockFreqs(size_t block, uint32_t* freqs) const {
+    const PostingBlock& info = blocks[block];
+    const uint32_t* data = packed + info.offset + PostingCodec::packedWords(info.doc_bits);
+    PostingCodec::unpack(data, freqs, info.freq_bits);
+    for (size_t i = 0; i < PostingCodec::BLOCK_SIZE; ++i) {
+        freqs[i] += 1;
+    }
+}
+
+void PostingView::decodeBlock(size_t block, uint32_t* doc_ids, uint32_t* freqs) const {
+    decodeBlockDocIds(block, doc_ids);
+    decodeBlockFreqs(block, freqs);
+}
+
+size_t PostingView::decodeTail(uint32_t* doc_ids, uint32_t* freqs) const {
+    size_t n = count % PostingCodec::BLOCK_SIZE;
+    uint32_t doc = num_blocks == 0 ? 0 : blocks[num_blocks - 1].last_doc;
+    
+    const uint8_t* p = tail;
+    for (size_t i = 0; i < n; ++i) {
+        doc += PostingCodec::readVarint(p);
+        doc_ids[i] = doc;
+        freqs[i] = PostingCodec::readVarint(p) + 1;
+    }
+    return n;
+}
+
+void PostingView::decode(std::vector<uint32_t>& doc_ids, std::vector<int>& freqs) const {
+    doc_ids.resize(count);
+    freqs.resize(count);
+    
+    uint32_t block_freqs[PostingCodec::BLOCK_SIZE];
+    size_t pos = 0;
+    for (size_t b = 0; b < num_blocks; ++b, pos += PostingCodec::BLOCK_SIZE) {
+        decodeBlock(b, doc_ids.data() + pos, block_freqs);
+        for (size_t i = 0; i < PostingCodec::BLOCK_SIZE; ++i) {
+            freqs[pos + i] = static_cast<int>(block_freqs[i]);
+        }
+    }
+    
+    size_t n = decodeTail(doc_ids.data() + pos, block_freqs);
+    for (size_t i = 0; i < n; ++i) {
+        freqs[pos + i] = static_cast<int>(block_freqs[i]);
+    }
+}
+
+void PostingView::decodeDocIds(std::vector<uint32_t>& doc_ids) const {
+    doc_ids.resize(count);
+    
+    size_t pos = 0;
+    for (size_t b = 0; b < num_blocks; ++b, pos += PostingCodec::BLOCK_SIZE) {
+        decodeBlockDocIds(b, doc_ids.data() + pos);
+    }
+    
+    uint32_t freqs[PostingCodec::BLOCK_SIZE];
+    decodeTail(doc_ids.data() + pos, freqs);
+}
+
+size_t PostingList::memoryUsage() const {
+    return sizeof(PostingList) + blocks.capacity() * sizeof(PostingBlock) +
+           packed.capacity() * sizeof(uint32_t) + tail.capacity() + positions.memoryUsage();
+}
+
+void PostingList::save(std::ostream& out) const {
+    uint32_t num_blocks = static_cast<uint32_t>(blocks.size());
+    uint32_t num_words = static_cast<uint32_t>(packed.size());
+    uint32_t tail_size = static_cast<uint32_t>(tail.size());
+    
+    out.write(reinterpret_cast<const char*>(&count), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&last_doc), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&num_blocks), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(blocks.data()), num_blocks * sizeof(PostingBlock));
+    out.write(reinterpret_cast<const char*>(&num_words), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(packed.data()), num_words * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&tail_size), sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(tail.data()), tail_size);
+    positions.save(out);
+}
+
+bool PostingList::load(std::istream& in) {
+    uint32_t num_blocks = 0, num_words = 0, tail_size = 0;
+    
+    in.read(reinterpret_cast<char*>(&count), sizeof(uint32_t));
+    in.read(reinterpret_cast<char*>(&last_doc), sizeof(uint32_t));
+    in.read(reinterpret_cast<char*>(&num_blocks), sizeof(uint32_t));
+    if (!in) return false;
+    blocks.resize(num_blocks);
+    in.read(reinterpret_cast<char*>(blocks.data()), num_blocks * sizeof(PostingBlock));
+    
+    in.read(reinterpret_cast<char*>(&num_words), sizeof(uint32_t));
+    if (!in) return false;
+    packed.resize(num_words);
+    in.read(reinterpret_cast<char*>(packed.data()), num_words * sizeof(uint32_t));
+    
+    in.read(reinterpret_cast<char*>(&tail_size), sizeof(uint32_t));
+    if (!in) return false;
+    tail.resize(tail_size);
+    in.read(reinterpret_cast<char*>(tail.data()), tail_size);
+    
+    return positions.load(in);
+}
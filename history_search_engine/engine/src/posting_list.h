@@ -0,0 +1,102 @@
+#ifndef POSTING_LIST_H
+#define POSTING_LIST_H
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "posting_codec.h"
+#include "position_list.h"
+
+struct PostingBlock {
+    uint32_t last_doc;
+    uint32_t offset;
+    uint8_t doc_bits;
+    uint8_t freq_bits;
+    // BM25 upper bound of the block as a fraction of the term's max_score
+    // in 1/65535 units, rounded up; 0 if not computed.
+    uint16_t score_bound;
+};
+
+// Read-only view of compressed postings, either owned by a PostingList or
+// pointing straight into a memory-mapped index file.
+struct PostingView {
+    const PostingBlock* blocks = nullptr;
+    const uint32_t* packed = nullptr;
+    const uint8_t* tail = nullptr;
+    uint32_t num_blocks = 0;
+    uint32_t num_words = 0;
+    uint32_t tail_size = 0;
+    uint32_t count = 0;
+    uint32_t last_doc = 0;
+    PositionView positions;
+    // BM25 upper bound stored in a mapped index; 0 if not known.
+    float max_score = 0.0f;
+    // Doc ID bitmap of a dense term in a mapped index (see DocBitmap).
+    const uint64_t* bitmap = nullptr;
+    uint32_t bitmap_words = 0;
+    
+    uint32_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool hasPositions() const { return !positions.empty(); }
+    bool hasBitmap() const { return bitmap_words != 0; }
+    uint32_t lastDocId() const { return last_doc; }
+    size_t numBlocks() const { return num_blocks; }
+    uint32_t blockLastDoc(size_t block) const { return blocks[block].last_doc; }
+    double blockMaxScore(size_t block) const {
+        if (block >= num_blocks || blocks[block].score_bound == 0) return max_score;
+        return max_score * (blocks[block].score_bound / 65535.0);
+    }
+    
+    // Decodes full block `block` into BLOCK_SIZE doc IDs and frequencies.
+    void decodeBlock(size_t block, uint32_t* doc_ids, uint32_t* freqs) const;
+    void decodeBlockDocIds(size_t block, uint32_t* doc_ids) const;
+    void decodeBlockFreqs(size_t block, uint32_t* freqs) const;
+    // Decodes the unpacked tail; returns the number of postings written.
+    size_t decodeTail(uint32_t* doc_ids, uint32_t* freqs) const;
+    
+    void decode(std::vector<uint32_t>& doc_ids, std::vector<int>& freqs) const;
+    void decodeDocIds(std::vector<uint32_t>& doc_ids) const;
+};
+
+// Compressed postings of one term, kept compressed in memory and on disk.
+// Doc IDs are delta-coded (the first delta of a block is taken from the
+// previous block's last doc ID) and frequencies are stored as freq - 1.
+// Every full block of 128 postings is bit-packed into `packed`; the
+// remaining postings are varbyte (delta, freq - 1) pairs in `tail` and get
+// packed as soon as the tail reaches a full block. Word positions are kept
+// only if they are passed to add().
+class PostingList {
+private:
+    std::vector<PostingBlock> blocks;
+    std::vector<uint32_t> packed;
+    std::vector<uint8_t> tail;
+    PositionList positions;
+    uint32_t count;
+    uint32_t last_doc;
+    
+    void packTail();
+    
+public:
+    PostingList();
+    // `doc_positions`, if given, holds the freq ascending word positions.
+    void add(uint32_t doc_id, int freq, const uint32_t* doc_positions = nullptr);
+    // Adds the postings of other, whose doc IDs all follow this list's.
+    void append(const PostingList& other);
+    
+    uint32_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    uint32_t lastDocId() const { return last_doc; }
+    
+    // The view is invalidated by the next add().
+    PostingView view() const;
+    void decode(std::vector<uint32_t>& doc_ids, std::vector<int>& freqs) const {
+        view().decode(doc_ids, freqs);
+    }
+    void decodeDocIds(std::vector<uint32_t>& doc_ids) const { view().decodeDocIds(doc_ids); }
+    
+    size_t memoryUsage() const;
+    void save(std::ostream& out) const;
+    bool load(std::istream& in);
+};
+
+#endif
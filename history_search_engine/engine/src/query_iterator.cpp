@@ -0,0 +1,418 @@
+#include "query_iterator.h"
+#include "set_operations.h"
+#include <algorithm>
+
+PositionalIterator::PositionalIterator(const PlanNode& group)
+    : phrase(group.phrase), distance(group.distance), estimate(group.cost) {
+    terms.reserve(group.group.size());
+    for (const auto& postings : group.group) {
+        terms.emplace_back(postings);
+    }
+    positions.resize(terms.size());
+    cursors.resize(terms.size());
+    doc = findMatch(terms[0].docId());
+}
+
+bool PositionalIterator::matchDocument() {
+    for (size_t t = 0; t < terms.size(); ++t) {
+        // Without a positional index a group degrades to AND, which
+        // BooleanSearch reports as a query warning.
+        if (!terms[t].hasPositions()) return true;
+        terms[t].positions(positions[t]);
+    }
+
+    std::fill(cursors.begin(), cursors.end(), 0);
+
+    if (phrase) {
+        for (uint32_t start : positions[0]) {
+            bool match = true;
+            for (size_t t = 1; t < positions.size() && match; ++t) {
+                const auto& list = positions[t];
+                while (cursors[t] < list.size() && list[cursors[t]] < start + t) {
+                    cursors[t]++;
+                }
+                if (cursors[t] == list.size()) return false;
+                match = list[cursors[t]] == start + t;
+            }
+            if (match) return true;
+        }
+        return false;
+    }
+
+    // Smallest window holding one position of every term: repeatedly
+    // advance the list whose current position is the smallest.
+    while (true) {
+        size_t min_list = 0;
+        uint32_t min_pos = positions[0][cursors[0]];
+        uint32_t max_pos = min_pos;
+        for (size_t t = 1; t < positions.size(); ++t) {
+            uint32_t p = positions[t][cursors[t]];
+            if (p < min_pos) {
+                min_pos = p;
+                min_list = t;
+            }
+            max_pos = std::max(max_pos, p);
+        }
+        if (max_pos - min_pos <= distance) return true;
+        if (++cursors[min_list] == positions[min_list].size()) return false;
+    }
+}
+
+uint32_t PositionalIterator::findMatch(uint32_t candidate) {
+    while (candidate != END) {
+        bool aligned = true;
+        for (auto& term : terms) {
+            uint32_t d = term.nextGEQ(candidate);
+            if (d != candidate) {
+                candidate = d;
+                aligned = false;
+                break;
+            }
+        }
+        if (!aligned) continue;
+
+        if (matchDocument()) return candidate;
+        candidate = terms[0].next();
+    }
+    return END;
+}
+
+uint32_t PositionalIterator::next() {
+    if (doc == END) return END;
+    return doc = findMatch(terms[0].next());
+}
+
+uint32_t PositionalIterator::nextGEQ(uint32_t target) {
+    if (doc >= target) return doc;
+    return doc = findMatch(terms[0].nextGEQ(target));
+}
+
+AndIterator::AndIterator(std::vector<std::unique_ptr<DocIterator>> operands)
+    : children(std::move(operands)), pair_a(nullptr), pair_b(nullptr),
+      pair_size(0), pair_pos(0), first_other(1) {
+    std::stable_sort(children.begin(), children.end(),
+                     [](const auto& a, const auto& b) { return a->cost() < b->cost(); });
+
+    if (children.size() >= 2) {
+        auto* a = dynamic_cast<TermIterator*>(children[0].get());
+        auto* b = dynamic_cast<TermIterator*>(children[1].get());
+        if (a && b) {
+            pair_a = &a->cursor();
+            pair_b = &b->cursor();
+            first_other = 2;
+            fillPair();
+        }
+    }
+    doc = align(leadDoc());
+}
+
+// Intersects the overlapping parts of the blocks the two term cursors meet
+// in next; false once either runs out.
+bool AndIterator::fillPair() {
+    pair_size = 0;
+    pair_pos = 0;
+
+    while (true) {
+        uint32_t doc_a = pair_a->docId();
+        uint32_t doc_b = pair_b->docId();
+        if (doc_a == END || doc_b == END) return false;
+
+        if (doc_a < doc_b) {
+            pair_a->nextGEQ(doc_b);
+            continue;
+        }
+        if (doc_b < doc_a) {
+            pair_b->nextGEQ(doc_a);
+            continue;
+        }
+
+        uint32_t limit = std::min(pair_a->blockLastDoc(), pair_b->blockLastDoc());
+        const uint32_t* pa = pair_a->blockDocIds();
+        const uint32_t* pb = pair_b->blockDocIds();
+        size_t na = std::upper_bound(pa, pa + pair_a->blockRemaining(), limit) - pa;
+        size_t nb = std::upper_bound(pb, pb + pair_b->blockRemaining(), limit) - pb;
+        pair_size = SetOperations::intersect(pa, na, pb, nb, pair_docs);
+
+        if (pair_a->blockLastDoc() > limit) {
+            pair_a->nextGEQ(limit + 1);
+            pair_b->nextGEQ(pair_a->docId());
+        } else {
+            pair_b->nextGEQ(limit + 1);
+            pair_a->nextGEQ(pair_b->docId());
+        }
+        return true;
+    }
+}
+
+uint32_t AndIterator::leadDoc() const {
+    if (!pair_a) return children[0]->docId();
+    return pair_pos < pair_size ? pair_docs[pair_pos] : END;
+}
+
+uint32_t AndIterator::leadNextGEQ(uint32_t target) {
+    if (!pair_a) return children[0]->nextGEQ(target);
+
+    pair_pos = std::lower_bound(pair_docs + pair_pos, pair_docs + pair_size, target) - pair_docs;
+    if (pair_pos == pair_size && pair_size > 0) {
+        // The cursors already stand past the buffered blocks.
+        pair_a->nextGEQ(target);
+        pair_b->nextGEQ(target);
+        fillPair();
+    }
+    return leadDoc();
+}
+
+// First document >= candidate, a match of the lead, that all operands match.
+uint32_t AndIterator::align(uint32_t candidate) {
+    while (candidate != END) {
+        uint32_t target = candidate;
+        for (size_t k = first_other; k < children.size(); ++k) {
+            uint32_t d = children[k]->nextGEQ(candidate);
+            if (d != candidate) {
+                target = d;
+                break;
+            }
+        }
+        if (target == candidate) return candidate;
+        candidate = leadNextGEQ(target);
+    }
+    return END;
+}
+
+uint32_t AndIterator::next() {
+    if (doc == END) return END;
+    return doc = align(leadNextGEQ(doc + 1));
+}
+
+uint32_t AndIterator::nextGEQ(uint32_t target) {
+    if (doc >= target) return doc;
+    return doc = align(leadNextGEQ(target));
+}
+
+OrIterator::OrIterator(std::vector<std::unique_ptr<DocIterator>> operands)
+    : children(std::move(operands)), estimate(0) {
+    for (const auto& child : children) {
+        estimate += child->cost();
+    }
+    updateDoc();
+}
+
+uint32_t OrIterator::updateDoc() {
+    doc = END;
+    for (const auto& child : children) {
+        doc = std::min(doc, child->docId());
+    }
+    return doc;
+}
+
+uint32_t OrIterator::next() {
+    if (doc == END) return END;
+    for (auto& child : children) {
+        if (child->docId() == doc) {
+            child->next();
+        }
+    }
+    return updateDoc();
+}
+
+uint32_t OrIterator::nextGEQ(uint32_t target) {
+    if (doc >= target) return doc;
+    for (auto& child : children) {
+        child->nextGEQ(target);
+    }
+    return updateDoc();
+}
+
+AndNotIterator::AndNotIterator(std::unique_ptr<DocIterator> include,
+                               std::vector<std::unique_ptr<DocIterator>> excluded)
+    : include(std::move(include)), excluded(std::move(excluded)) {
+    doc = skipExcluded(this->include->docId());
+}
+
+uint32_t AndNotIterator::skipExcluded(uint32_t candidate) {
+    while (candidate != END) {
+        bool hit = false;
+        for (auto& child : excluded) {
+            if (child->nextGEQ(candidate) == candidate) {
+                hit = true;
+                break;
+            }
+        }
+        if (!hit) return candidate;
+        candidate = include->next();
+    }
+    return END;
+}
+
+uint32_t AndNotIterator::nextGEQ(uint32_t target) {
+    if (doc >= target) return doc;
+    return doc = skipExcluded(include->nextGEQ(target));
+}
+
+NotIterator::NotIterator(std::unique_ptr<DocIterator> child, uint32_t num_docs)
+    : child(std::move(child)), num_docs(num_docs) {
+    doc = skipMatches(0);
+}
+
+uint32_t NotIterator::skipMatches(uint32_t candidate) {
+    while (candidate < num_docs && child->nextGEQ(candidate) == candidate) {
+        ++candidate;
+    }
+    return candidate < num_docs ? candidate : END;
+}
+
+uint32_t NotIterator::next() {
+    if (doc == END) return END;
+    return doc = skipMatches(doc + 1);
+}
+
+uint32_t NotIterator::nextGEQ(uint32_t target) {
+    if (doc >= target) return doc;
+    return doc = skipMatches(target);
+}
+
+size_t NotIterator::cost() const {
+    return num_docs - std::min<size_t>(child->cost(), num_docs);
+}
+
+BitmapIterator::BitmapIterator(DocBitmap bitmap)
+    : bitmap(std::move(bitmap)) {
+    matches = this->bitmap.count();
+    doc = this->bitmap.nextSet(0);
+}
+
+uint32_t BitmapIterator::next() {
+    if (doc == END) return END;
+    return doc = bitmap.nextSet(doc + 1);
+}
+
+uint32_t BitmapIterator::nextGEQ(uint32_t target) {
+    if (doc >= target) return doc;
+    return doc = bitmap.nextSet(target);
+}
+
+LiveIterator::LiveIterator(std::unique_ptr<DocIterator> child, const DocBitmap* deleted)
+    : child(std::move(child)), deleted(deleted) {
+    doc = skipDeleted(this->child->docId());
+}
+
+uint32_t LiveIterator::skipDeleted(uint32_t candidate) {
+    while (candidate != END && deleted->test(candidate)) {
+        candidate = child->next();
+    }
+    return candidate;
+}
+
+uint32_t LiveIterator::nextGEQ(uint32_t target) {
+    if (doc >= target) return doc;
+    return doc = skipDeleted(child->nextGEQ(target));
+}
+
+static bool bitmapEvaluable(const PlanNode& plan) {
+    if (plan.type == PlanType::TERM) return true;
+    if (plan.type == PlanType::POSITIONAL || plan.type == PlanType::EMPTY) return false;
+
+    for (const auto& child : plan.children) {
+        if (!bitmapEvaluable(*child)) return false;
+    }
+    for (const auto& child : plan.excluded) {
+        if (!bitmapEvaluable(*child)) return false;
+    }
+    return true;
+}
+
+static void evaluateBitmap(const PlanNode& plan, DocBitmap& out) {
+    DocBitmap part(out.size());
+    auto combine = [&part](const PlanNode& child, auto term_op, auto bitmap_op) {
+        if (child.type == PlanType::TERM) {
+            term_op(child.postings);
+        } else {
+            evaluateBitmap(child, part);
+            bitmap_op(part);
+        }
+    };
+
+    switch (plan.type) {
+        case PlanType::TERM:
+            out.assign(plan.postings);
+            break;
+        case PlanType::AND:
+        case PlanType::OR: {
+            bool conjunction = plan.type == PlanType::AND;
+            evaluateBitmap(*plan.children[0], out);
+            for (size_t k = 1; k < plan.children.size(); ++k) {
+                if (conjunction) {
+                    combine(*plan.children[k],
+                            [&out](const PostingView& p) { out.intersect(p); },
+                            [&out](const DocBitmap& b) { out.intersect(b); });
+                } else {
+                    combine(*plan.children[k],
+                            [&out](const PostingView& p) { out.unite(p); },
+                            [&out](const DocBitmap& b) { out.unite(b); });
+                }
+            }
+            for (const auto& child : plan.excluded) {
+                combine(*child,
+                        [&out](const PostingView& p) { out.subtract(p); },
+                        [&out](const DocBitmap& b) { out.subtract(b); });
+            }
+            break;
+        }
+        case PlanType::NOT:
+            evaluateBitmap(*plan.children[0], out);
+            out.flip();
+            break;
+        case PlanType::POSITIONAL:
+        case PlanType::EMPTY:
+            out.reset(out.size());
+            break;
+    }
+}
+
+std::unique_ptr<DocIterator> buildIterator(const PlanNode& plan, uint32_t num_docs) {
+    if (plan.type != PlanType::TERM && DocBitmap::isDense(plan.cost, num_docs) &&
+        bitmapEvaluable(plan)) {
+        DocBitmap bitmap(num_docs);
+        evaluateBitmap(plan, bitmap);
+        return std::make_unique<BitmapIterator>(std::move(bitmap));
+    }
+
+    switch (plan.type) {
+        case PlanType::TERM:
+            return std::make_unique<TermIterator>(plan.postings);
+        case PlanType::POSITIONAL:
+            return std::make_unique<PositionalIterator>(plan);
+        case PlanType::AND: {
+            std::vector<std::unique_ptr<DocIterator>> children;
+            for (const auto& child : plan.children) {
+                children.push_back(buildIterator(*child, num_docs));
+            }
+            std::unique_ptr<DocIterator> include;
+            if (children.size() == 1) {
+                include = std::move(children[0]);
+            } else {
+                include = std::make_unique<AndIterator>(std::move(children));
+            }
+            if (plan.excluded.empty()) return include;
+
+            std::vector<std::unique_ptr<DocIterator>> excluded;
+            for (const auto& child : plan.excluded) {
+                excluded.push_back(buildIterator(*child, num_docs));
+            }
+            return std::make_unique<AndNotIterator>(std::move(include), std::move(excluded));
+        }
+        case PlanType::OR: {
+            std::vector<std::unique_ptr<DocIterator>> children;
+            for (const auto& child : plan.children) {
+                children.push_back(buildIterator(*child, num_docs));
+            }
+            return std::make_unique<OrIterator>(std::move(children));
+        }
+        case PlanType::NOT:
+            return std::make_unique<NotIterator>(buildIterator(*plan.children[0], num_docs),
+                                                 num_docs);
+        case PlanType::EMPTY:
+            break;
+    }
+    return std::make_unique<EmptyIterator>();
+}
@@ -0,0 +1,202 @@
+#ifndef QUERY_ITERATOR_H
+#define QUERY_ITERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "doc_bitmap.h"
+#include "posting_codec.h"
+#include "posting_iterator.h"
+#include "query_planner.h"
+
+// Lazy document-at-a-time evaluation of a query plan. Every iterator starts
+// on its first match and moves forward on demand, so a query holds only its
+// cursors and never a materialized intermediate result.
+class DocIterator {
+public:
+    static const uint32_t END = PostingIterator::END;
+
+    virtual ~DocIterator() = default;
+
+    virtual uint32_t docId() const = 0;
+    virtual uint32_t next() = 0;
+    // Moves to the first match with doc ID >= target and returns it (or END).
+    virtual uint32_t nextGEQ(uint32_t target) = 0;
+    // Estimated number of matches.
+    virtual size_t cost() const = 0;
+
+    bool atEnd() const { return docId() == END; }
+};
+
+class EmptyIterator : public DocIterator {
+public:
+    uint32_t docId() const override { return END; }
+    uint32_t next() override { return END; }
+    uint32_t nextGEQ(uint32_t) override { return END; }
+    size_t cost() const override { return 0; }
+};
+
+class TermIterator : public DocIterator {
+private:
+    PostingIterator postings;
+
+public:
+    explicit TermIterator(const PostingView& list) : postings(list) {}
+
+    PostingIterator& cursor() { return postings; }
+
+    uint32_t docId() const override { return postings.docId(); }
+    uint32_t next() override { return postings.next(); }
+    uint32_t nextGEQ(uint32_t target) override { return postings.nextGEQ(target); }
+    size_t cost() const override { return postings.size(); }
+};
+
+// Documents where the terms of a group occur as a phrase, or all within
+// `distance` positions of each other.
+class PositionalIterator : public DocIterator {
+private:
+    std::vector<PostingIterator> terms;
+    std::vector<std::vector<uint32_t>> positions;
+    std::vector<size_t> cursors;
+    bool phrase;
+    uint32_t distance;
+    uint32_t doc;
+    size_t estimate;
+
+    bool matchDocument();
+    uint32_t findMatch(uint32_t target);
+
+public:
+    explicit PositionalIterator(const PlanNode& group);
+
+    uint32_t docId() const override { return doc; }
+    uint32_t next() override;
+    uint32_t nextGEQ(uint32_t target) override;
+    size_t cost() const override { return estimate; }
+};
+
+// Conjunction of operands ordered by ascending cost. When the two cheapest
+// are plain terms their overlapping blocks are intersected with the
+// SetOperations kernels a block at a time; the other operands then only
+// confirm candidates with nextGEQ.
+class AndIterator : public DocIterator {
+private:
+    std::vector<std::unique_ptr<DocIterator>> children;
+    PostingIterator* pair_a;
+    PostingIterator* pair_b;
+    uint32_t pair_docs[PostingCodec::BLOCK_SIZE];
+    size_t pair_size;
+    size_t pair_pos;
+    size_t first_other;
+    uint32_t doc;
+
+    bool fillPair();
+    uint32_t leadDoc() const;
+    uint32_t leadNextGEQ(uint32_t target);
+    uint32_t align(uint32_t candidate);
+
+public:
+    explicit AndIterator(std::vector<std::unique_ptr<DocIterator>> children);
+
+    uint32_t docId() const override { return doc; }
+    uint32_t next() override;
+    uint32_t nextGEQ(uint32_t target) override;
+    size_t cost() const override { return children[0]->cost(); }
+};
+
+class OrIterator : public DocIterator {
+private:
+    std::vector<std::unique_ptr<DocIterator>> children;
+    uint32_t doc;
+    size_t estimate;
+
+    uint32_t updateDoc();
+
+public:
+    explicit OrIterator(std::vector<std::unique_ptr<DocIterator>> children);
+
+    uint32_t docId() const override { return doc; }
+    uint32_t next() override;
+    uint32_t nextGEQ(uint32_t target) override;
+    size_t cost() const override { return estimate; }
+};
+
+// Matches of `include` that no excluded operand matches.
+class AndNotIterator : public DocIterator {
+private:
+    std::unique_ptr<DocIterator> include;
+    std::vector<std::unique_ptr<DocIterator>> excluded;
+    uint32_t doc;
+
+    uint32_t skipExcluded(uint32_t candidate);
+
+public:
+    AndNotIterator(std::unique_ptr<DocIterator> include,
+                   std::vector<std::unique_ptr<DocIterator>> excluded);
+
+    uint32_t docId() const override { return doc; }
+    uint32_t next() override { return doc = skipExcluded(include->next()); }
+    uint32_t nextGEQ(uint32_t target) override;
+    size_t cost() const override { return include->cost(); }
+};
+
+// Every document in [0, num_docs) that the child does not match.
+class NotIterator : public DocIterator {
+private:
+    std::unique_ptr<DocIterator> child;
+    uint32_t num_docs;
+    uint32_t doc;
+
+    uint32_t skipMatches(uint32_t candidate);
+
+public:
+    NotIterator(std::unique_ptr<DocIterator> child, uint32_t num_docs);
+
+    uint32_t docId() const override { return doc; }
+    uint32_t next() override;
+    uint32_t nextGEQ(uint32_t target) override;
+    size_t cost() const override;
+};
+
+// Matches of a subtree evaluated word-parallel into a bitmap.
+class BitmapIterator : public DocIterator {
+private:
+    DocBitmap bitmap;
+    uint32_t doc;
+    size_t matches;
+
+public:
+    explicit BitmapIterator(DocBitmap bitmap);
+
+    uint32_t docId() const override { return doc; }
+    uint32_t next() override;
+    uint32_t nextGEQ(uint32_t target) override;
+    size_t cost() const override { return matches; }
+};
+
+// Matches of the child that are not marked deleted in a segment's
+// tombstone bitmap.
+class LiveIterator : public DocIterator {
+private:
+    std::unique_ptr<DocIterator> child;
+    const DocBitmap* deleted;
+    uint32_t doc;
+
+    uint32_t skipDeleted(uint32_t candidate);
+
+public:
+    LiveIterator(std::unique_ptr<DocIterator> child, const DocBitmap* deleted);
+
+    uint32_t docId() const override { return doc; }
+    uint32_t next() override { return doc = skipDeleted(child->next()); }
+    uint32_t nextGEQ(uint32_t target) override;
+    size_t cost() const override { return child->cost(); }
+};
+
+// Builds the iterator tree for a plan. Boolean subtrees whose result is
+// estimated to be dense (see DocBitmap::DENSE_RATIO) are evaluated into a
+// bitmap with word-parallel AND/OR/ANDNOT instead of merging sorted lists.
+std::unique_ptr<DocIterator> buildIterator(const PlanNode& plan, uint32_t num_docs);
+
+#endif
@@ -0,0 +1,235 @@
+#include "query_parser.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <limits>
+#include <sstream>
+
+QueryParser::QueryParser() : pos(0), depth(0) {}
+
+void QueryParser::fail(const std::string& message) {
+    if (error.empty()) error = message;
+    pos = lexemes.size() - 1;
+}
+
+bool QueryParser::descend() {
+    if (depth == MAX_DEPTH) {
+        fail("query nested deeper than " + std::to_string(MAX_DEPTH) + " levels");
+        return false;
+    }
+    ++depth;
+    return true;
+}
+
+bool QueryParser::parseDistance(const std::string& digits, uint32_t& distance) {
+    if (digits.empty()) return false;
+    uint64_t value = 0;
+    auto result = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+    if (result.ptr != digits.data() + digits.size()) return false;
+    // Wider windows than any document are all the same window.
+    if (result.ec == std::errc::result_out_of_range ||
+        value > std::numeric_limits<uint32_t>::max()) {
+        value = std::numeric_limits<uint32_t>::max();
+    }
+    distance = static_cast<uint32_t>(value);
+    return true;
+}
+
+std::string QueryParser::normalize(std::string_view text) {
+    std::string words;
+    tokenizer.forEachToken(text, [&words](std::string_view token, size_t) {
+        if (!words.empty()) words += ' ';
+        words += token;
+    });
+    return words;
+}
+
+void QueryParser::tokenize(const std::string& query) {
+    lexemes.clear();
+    pos = 0;
+    
+    auto isSpace = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    size_t i = 0;
+    
+    while (i < query.length()) {
+        char c = query[i];
+        if (isSpace(c)) {
+            ++i;
+            continue;
+        }
+        
+        if (c == '(' || c == ')') {
+            lexemes.push_back({c == '(' ? Kind::LPAREN : Kind::RPAREN, "", 0});
+            ++i;
+            continue;
+        }
+        
+        if (c == '"') {
+            size_t close = query.find('"', i + 1);
+            if (close == std::string::npos) close = query.length();
+            std::string_view phrase(query.data() + i + 1, close - i - 1);
+            lexemes.push_back({Kind::PHRASE, normalize(phrase), 0});
+            i = close + 1;
+            continue;
+        }
+        
+        size_t end = i;
+        while (end < query.length() && !isSpace(query[end]) &&
+               query[end] != '"' && query[end] != '(' && query[end] != ')') {
+            ++end;
+        }
+        std::string word = query.substr(i, end - i);
+        i = end;
+        
+        std::string upper = word;
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        uint32_t distance = 0;
+        
+        if (upper == "AND") {
+            lexemes.push_back({Kind::AND, "", 0});
+        } else if (upper == "OR") {
+            lexemes.push_back({Kind::OR, "", 0});
+        } else if (upper == "NOT") {
+            lexemes.push_back({Kind::NOT, "", 0});
+        } else if (upper.compare(0, 5, "NEAR/") == 0 && parseDistance(upper.substr(5), distance)) {
+            lexemes.push_back({Kind::NEAR, "", distance});
+        } else {
+            std::string words = normalize(word);
+            if (words.find(' ') != std::string::npos) {
+                lexemes.push_back({Kind::PHRASE, words, 0});
+            } else if (!words.empty()) {
+                lexemes.push_back({Kind::WORD, words, 0});
+            }
+        }
+    }
+    
+    lexemes.push_back({Kind::END, "", 0});
+}
+
+bool QueryParser::startsOperand(Kind kind) {
+    return kind == Kind::WORD || kind == Kind::PHRASE || kind == Kind::LPAREN || kind == Kind::NOT;
+}
+
+std::unique_ptr<QueryNode> QueryParser::combine(QueryNodeType type,
+                                                std::vector<std::unique_ptr<QueryNode>> children) {
+    if (children.empty()) return nullptr;
+    if (children.size() == 1) return std::move(children[0]);
+    
+    auto node = std::make_unique<QueryNode>(type);
+    node->children = std::move(children);
+    return node;
+}
+
+std::unique_ptr<QueryNode> QueryParser::parse(const std::string& query) {
+    tokenize(query);
+    depth = 0;
+    error.clear();
+    
+    std::vector<std::unique_ptr<QueryNode>> parts;
+    while (peek() != Kind::END) {
+        size_t start = pos;
+        auto node = parseOr();
+        if (node) {
+            parts.push_back(std::move(node));
+        } else if (pos == start) {
+            ++pos;  // a stray ")" or operator
+        }
+    }
+    if (!error.empty()) return nullptr;
+    return combine(QueryNodeType::AND, std::move(parts));
+}
+
+std::unique_ptr<QueryNode> QueryParser::parseOr() {
+    std::vector<std::unique_ptr<QueryNode>> children;
+    auto first = parseAnd();
+    if (first) children.push_back(std::move(first));
+    
+    while (peek() == Kind::OR) {
+        ++pos;
+        auto next = parseAnd();
+        if (next) children.push_back(std::move(next));
+    }
+    return combine(QueryNodeType::OR, std::move(children));
+}
+
+std::unique_ptr<QueryNode> QueryParser::parseAnd() {
+    std::vector<std::unique_ptr<QueryNode>> children;
+    
+    while (true) {
+        if (peek() == Kind::AND) {
+            ++pos;
+            continue;
+        }
+        if (!startsOperand(peek())) break;
+        
+        auto node = parseUnary();
+        if (node) children.push_back(std::move(node));
+    }
+    return combine(QueryNodeType::AND, std::move(children));
+}
+
+std::unique_ptr<QueryNode> QueryParser::parseUnary() {
+    if (peek() != Kind::NOT) return parsePrimary();
+    
+    ++pos;
+    if (!descend()) return nullptr;
+    auto operand = startsOperand(peek()) ? parseUnary() : nullptr;
+    --depth;
+    if (!operand) return nullptr;
+    
+    auto node = std::make_unique<QueryNode>(QueryNodeType::NOT);
+    node->children.push_back(std::move(operand));
+    return node;
+}
+
+std::unique_ptr<QueryNode> QueryParser::parsePrimary() {
+    Lexeme lexeme = lexemes[pos++];
+    
+    if (lexeme.kind == Kind::LPAREN) {
+        if (!descend()) return nullptr;
+        auto inner = parseOr();
+        --depth;
+        if (peek() == Kind::RPAREN) ++pos;
+        return inner;
+    }
+    
+    if (lexeme.kind == Kind::PHRASE) {
+        std::istringstream words(lexeme.text);
+        std::vector<std::string> terms;
+        std::string word;
+        while (words >> word) {
+            terms.push_back(word);
+        }
+        if (terms.empty()) return nullptr;
+        
+        auto node = std::make_unique<QueryNode>(terms.size() == 1 ? QueryNodeType::TERM
+                                                                   : QueryNodeType::PHRASE);
+        if (terms.size() == 1) {
+            node->term = terms[0];
+        } else {
+            node->terms = std::move(terms);
+        }
+        return node;
+    }
+    
+    auto node = std::make_unique<QueryNode>(QueryNodeType::TERM);
+    node->term = lexeme.text;
+    
+    // a NEAR/k b NEAR/k c forms one group, all within k of each other. The
+    // group has a single window, so a chain may not mix different k.
+    while (peek() == Kind::NEAR && lexemes[pos + 1].kind == Kind::WORD) {
+        if (node->type == QueryNodeType::TERM) {
+            node->type = QueryNodeType::NEAR;
+            node->terms.push_back(node->term);
+            node->term.clear();
+            node->distance = lexemes[pos].distance;
+        } else if (node->distance != lexemes[pos].distance) {
+            fail("NEAR chain mixes NEAR/" + std::to_string(node->distance) + " and NEAR/" +
+                 std::to_string(lexemes[pos].distance) + "; use one window");
+            return nullptr;
+        }
+        node->terms.push_back(lexemes[pos + 1].text);
+        pos += 2;
+    }
+    return node;
+}
@@ -0,0 +1,95 @@
+#ifndef QUERY_PARSER_H
+#define QUERY_PARSER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "tokenizer.h"
+
+enum class QueryNodeType {
+    TERM,
+    PHRASE,
+    NEAR,
+    AND,
+    OR,
+    NOT
+};
+
+// Query syntax tree. PHRASE holds terms that must occur at consecutive
+// positions in order, NEAR terms that must all occur within `distance`
+// positions of each other; NOT has exactly one child.
+struct QueryNode {
+    QueryNodeType type;
+    std::string term;
+    std::vector<std::string> terms;
+    uint32_t distance = 0;
+    std::vector<std::unique_ptr<QueryNode>> children;
+    
+    explicit QueryNode(QueryNodeType type) : type(type) {}
+};
+
+// Recursive descent parser for
+//
+//   or    := and ("OR" and)*
+//   and   := unary (["AND"] unary)*
+//   unary := "NOT" unary | primary
+//   primary := "(" or ")" | "\"" word* "\"" | word ("NEAR/k" word)*
+//
+// so NOT binds tighter than AND, and AND tighter than OR; juxtaposition
+// means AND. The parser is lenient: unbalanced parentheses and dangling
+// operators are ignored rather than rejected. A query fails only if it
+// nests parentheses or NOTs deeper than MAX_DEPTH, which bounds the
+// recursion, or chains NEAR with different windows, as in
+// a NEAR/1 b NEAR/10 c, since a group has a single window.
+//
+// Words are split and case-folded by the Tokenizer used at index time, so
+// "Кутузов," finds кутузов. A word that splits into several tokens is
+// searched as a phrase; one without any is dropped.
+class QueryParser {
+private:
+    enum class Kind { WORD, PHRASE, LPAREN, RPAREN, AND, OR, NOT, NEAR, END };
+    
+    struct Lexeme {
+        Kind kind;
+        std::string text;
+        uint32_t distance;
+    };
+    
+    std::vector<Lexeme> lexemes;
+    size_t pos;
+    size_t depth;
+    std::string error;
+    Tokenizer tokenizer;
+    
+    void tokenize(const std::string& query);
+    // The index terms of text, separated by single spaces.
+    std::string normalize(std::string_view text);
+    // Reads the k of NEAR/k; k beyond uint32_t is clamped.
+    static bool parseDistance(const std::string& digits, uint32_t& distance);
+    Kind peek() const { return lexemes[pos].kind; }
+    // Records the error and skips to the end of the query.
+    void fail(const std::string& message);
+    // Enters one more level of nesting; fails past MAX_DEPTH.
+    bool descend();
+    
+    std::unique_ptr<QueryNode> parseOr();
+    std::unique_ptr<QueryNode> parseAnd();
+    std::unique_ptr<QueryNode> parseUnary();
+    std::unique_ptr<QueryNode> parsePrimary();
+    
+    static bool startsOperand(Kind kind);
+    static std::unique_ptr<QueryNode> combine(QueryNodeType type,
+                                              std::vector<std::unique_ptr<QueryNode>> children);
+    
+public:
+    static const size_t MAX_DEPTH = 100;
+    
+    QueryParser();
+    // Returns nullptr for a query without any terms, or for one that fails
+    // to parse, which getError() then describes.
+    std::unique_ptr<QueryNode> parse(const std::string& query);
+    const std::string& getError() const { return error; }
+};
+
+#endif
@@ -0,0 +1,206 @@
+#include "query_planner.h"
+#include <algorithm>
+
+QueryPlanner::QueryPlanner(StemCache* stems) : index(nullptr), stems(stems) {}
+
+std::unique_ptr<PlanNode> QueryPlanner::plan(const QueryNode* node, const InvertedIndex& index) {
+    this->index = &index;
+    return planNode(node);
+}
+
+std::unique_ptr<PlanNode> QueryPlanner::planNode(const QueryNode* node) {
+    if (!node) return std::make_unique<PlanNode>(PlanType::EMPTY);
+    
+    switch (node->type) {
+        case QueryNodeType::TERM:
+            return planTerm(node->term);
+        case QueryNodeType::PHRASE:
+        case QueryNodeType::NEAR:
+            return planGroup(*node);
+        case QueryNodeType::AND:
+            return planAnd(*node);
+        case QueryNodeType::OR:
+            return planOr(*node);
+        case QueryNodeType::NOT:
+            return planNot(planNode(node->children[0].get()));
+    }
+    return std::make_unique<PlanNode>(PlanType::EMPTY);
+}
+
+std::unique_ptr<PlanNode> QueryPlanner::planTerm(const std::string& term) {
+    const std::string& stem = stems->stem(term);
+    PostingView postings = index->getPostings(stem);
+    if (postings.empty()) return std::make_unique<PlanNode>(PlanType::EMPTY);
+    
+    auto node = std::make_unique<PlanNode>(PlanType::TERM);
+    node->postings = postings;
+    node->terms.push_back(stem);
+    node->cost = postings.size();
+    return node;
+}
+
+std::unique_ptr<PlanNode> QueryPlanner::planGroup(const QueryNode& query) {
+    auto node = std::make_unique<PlanNode>(PlanType::POSITIONAL);
+    node->phrase = query.type == QueryNodeType::PHRASE;
+    node->distance = query.distance;
+    node->cost = index->getTotalDocuments();
+    
+    for (const auto& term : query.terms) {
+        const std::string& stem = stems->stem(term);
+        PostingView postings = index->getPostings(stem);
+        if (postings.empty()) return std::make_unique<PlanNode>(PlanType::EMPTY);
+        node->group.push_back(postings);
+        node->terms.push_back(stem);
+        node->cost = std::min<size_t>(node->cost, postings.size());
+    }
+    return node;
+}
+
+std::unique_ptr<PlanNode> QueryPlanner::planNot(std::unique_ptr<PlanNode> child) {
+    if (child->type == PlanType::NOT) {
+        return std::move(child->children[0]);
+    }
+    
+    auto node = std::make_unique<PlanNode>(PlanType::NOT);
+    node->cost = index->getTotalDocuments() - std::min(child->cost, index->getTotalDocuments());
+    node->children.push_back(std::move(child));
+    return node;
+}
+
+std::unique_ptr<PlanNode> QueryPlanner::planAnd(const QueryNode& query) {
+    auto node = std::make_unique<PlanNode>(PlanType::AND);
+    
+    for (const auto& child_query : query.children) {
+        auto child = planNode(child_query.get());
+        if (child->type == PlanType::EMPTY) return child;
+        
+        if (child->type == PlanType::AND) {
+            for (auto& grandchild : child->children) {
+                node->children.push_back(std::move(grandchild));
+            }
+            for (auto& grandchild : child->excluded) {
+                node->excluded.push_back(std::move(grandchild));
+            }
+        } else if (child->type == PlanType::NOT) {
+            // A AND NOT B becomes A AND-NOT B.
+            auto& negated = child->children[0];
+            if (negated->type != PlanType::EMPTY) {
+                node->excluded.push_back(std::move(negated));
+            }
+        } else {
+            node->children.push_back(std::move(child));
+        }
+    }
+    
+    if (node->children.empty()) {
+        // Only negations: the complement of their union.
+        if (node->excluded.empty()) return std::make_unique<PlanNode>(PlanType::EMPTY);
+        auto excluded = std::make_unique<PlanNode>(PlanType::OR);
+        for (auto& child : node->excluded) {
+            excluded->cost += child->cost;
+            excluded->children.push_back(std::move(child));
+        }
+        if (excluded->children.size() == 1) {
+            return planNot(std::move(excluded->children[0]));
+        }
+        return planNot(std::move(excluded));
+    }
+    
+    std::stable_sort(node->children.begin(), node->children.end(),
+                     [](const auto& a, const auto& b) { return a->cost < b->cost; });
+    std::stable_sort(node->excluded.begin(), node->excluded.end(),
+                     [](const auto& a, const auto& b) { return a->cost > b->cost; });
+    
+    if (node->children.size() == 1 && node->excluded.empty()) {
+        return std::move(node->children[0]);
+    }
+    node->cost = node->children[0]->cost;
+    return node;
+}
+
+std::unique_ptr<PlanNode> QueryPlanner::planOr(const QueryNode& query) {
+    auto node = std::make_unique<PlanNode>(PlanType::OR);
+    
+    for (const auto& child_query : query.children) {
+        auto child = planNode(child_query.get());
+        if (child->type == PlanType::EMPTY) continue;
+        
+        if (child->type == PlanType::OR) {
+            for (auto& grandchild : child->children) {
+                node->children.push_back(std::move(grandchild));
+            }
+        } else {
+            node->children.push_back(std::move(child));
+        }
+    }
+    
+    if (node->children.empty()) return std::make_unique<PlanNode>(PlanType::EMPTY);
+    if (node->children.size() == 1) return std::move(node->children[0]);
+    
+    for (const auto& child : node->children) {
+        node->cost += child->cost;
+    }
+    node->cost = std::min(node->cost, index->getTotalDocuments());
+    return node;
+}
+
+void QueryPlanner::appendKey(const QueryNode& node, std::string& key) {
+    auto appendTerm = [this, &key](const std::string& term) {
+        const std::string& stem = stems->stem(term);
+        key += std::to_string(stem.length());
+        key += ':';
+        key += stem;
+    };
+    
+    switch (node.type) {
+        case QueryNodeType::TERM:
+            appendTerm(node.term);
+            return;
+        case QueryNodeType::PHRASE:
+        case QueryNodeType::NEAR:
+            key += node.type == QueryNodeType::PHRASE ? "P(" : "N" + std::to_string(node.distance) + "(";
+            for (const auto& term : node.terms) {
+                appendTerm(term);
+            }
+            key += ')';
+            return;
+        case QueryNodeType::NOT:
+            key += "!(";
+            appendKey(*node.children[0], key);
+            key += ')';
+            return;
+        case QueryNodeType::AND:
+        case QueryNodeType::OR:
+            break;
+    }
+    
+    // Flatten operands of the same kind, then order them.
+    std::vector<const QueryNode*> pending{&node};
+    std::vector<std::string> operands;
+    while (!pending.empty()) {
+        const QueryNode* current = pending.back();
+        pending.pop_back();
+        for (const auto& child : current->children) {
+            if (child->type == node.type) {
+                pending.push_back(child.get());
+            } else {
+                operands.emplace_back();
+                appendKey(*child, operands.back());
+            }
+        }
+    }
+    std::sort(operands.begin(), operands.end());
+    
+    key += node.type == QueryNodeType::AND ? "&(" : "|(";
+    for (const auto& operand : operands) {
+        key += operand;
+        key += ' ';
+    }
+    key += ')';
+}
+
+std::string QueryPlanner::canonicalKey(const QueryNode* node) {
+    std::string key;
+    if (node) appendKey(*node, key);
+    return key;
+}
@@ -0,0 +1,70 @@
+#ifndef QUERY_PLANNER_H
+#define QUERY_PLANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "inverted_index.h"
+#include "posting_list.h"
+#include "query_parser.h"
+#include "stem_cache.h"
+
+enum class PlanType {
+    EMPTY,
+    TERM,
+    POSITIONAL,
+    AND,
+    OR,
+    NOT
+};
+
+// Executable form of a query. AND keeps its positive operands ordered by
+// ascending cost and its negated operands separately (AND-NOT); NOT only
+// remains where there is nothing to subtract from, and means the
+// complement within all documents. `cost` estimates the number of matches.
+// Leaves keep their stems in `terms`, one per postings list.
+struct PlanNode {
+    PlanType type;
+    size_t cost = 0;
+    PostingView postings;
+    std::vector<PostingView> group;
+    std::vector<std::string> terms;
+    bool phrase = false;
+    uint32_t distance = 0;
+    std::vector<std::unique_ptr<PlanNode>> children;
+    std::vector<std::unique_ptr<PlanNode>> excluded;
+    
+    explicit PlanNode(PlanType type) : type(type) {}
+};
+
+// Turns a query tree into a plan: terms are stemmed and looked up, unknown
+// terms become EMPTY, which empties the enclosing AND and drops out of an
+// OR, nested AND/OR nodes are flattened and conjunctions are reordered so
+// that the cheapest operand drives the intersection. A plan refers to the
+// postings of the index it was made for, so a segmented index is planned
+// once per segment.
+class QueryPlanner {
+private:
+    const InvertedIndex* index;
+    StemCache* stems;
+    
+    std::unique_ptr<PlanNode> planNode(const QueryNode* node);
+    std::unique_ptr<PlanNode> planTerm(const std::string& term);
+    std::unique_ptr<PlanNode> planGroup(const QueryNode& node);
+    std::unique_ptr<PlanNode> planAnd(const QueryNode& node);
+    std::unique_ptr<PlanNode> planOr(const QueryNode& node);
+    std::unique_ptr<PlanNode> planNot(std::unique_ptr<PlanNode> child);
+    void appendKey(const QueryNode& node, std::string& key);
+    
+public:
+    explicit QueryPlanner(StemCache* stems);
+    std::unique_ptr<PlanNode> plan(const QueryNode* node, const InvertedIndex& index);
+    // Canonical form of a query tree for caching: terms are stemmed, nested
+    // AND/OR are flattened and their operands sorted, so reordered
+    // or reparenthesized queries share a key.
+    std::string canonicalKey(const QueryNode* node);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "ranking.h"
+#include <algorithm>
+#include <cmath>
+
+Bm25::Bm25(size_t num_docs, double avg_length)
+    : num_docs(static_cast<double>(num_docs)), avg_length(avg_length > 0 ? avg_length : 1.0) {}
+
+double Bm25::idf(uint32_t doc_freq) const {
+    return std::log(1.0 + (num_docs - doc_freq + 0.5) / (doc_freq + 0.5));
+}
+
+double Bm25::score(uint32_t freq, uint32_t doc_length, double idf) const {
+    double norm = K1 * (1.0 - B + B * doc_length / avg_length);
+    return idf * freq * (K1 + 1.0) / (freq + norm);
+}
+
+float Bm25::maxScore(const PostingView& postings, const DocumentTable& documents,
+                     std::vector<double>& block_max) const {
+    uint32_t doc_ids[PostingCodec::BLOCK_SIZE];
+    uint32_t freqs[PostingCodec::BLOCK_SIZE];
+    double term_idf = idf(postings.size());
+    
+    auto maxOf = [&](size_t n) {
+        double best = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            best = std::max(best, score(freqs[i], documents.getLength(doc_ids[i]), term_idf));
+        }
+        return best;
+    };
+    
+    block_max.resize(postings.numBlocks());
+    double best = 0.0;
+    for (size_t b = 0; b < postings.numBlocks(); ++b) {
+        postings.decodeBlock(b, doc_ids, freqs);
+        block_max[b] = maxOf(PostingCodec::BLOCK_SIZE);
+        best = std::max(best, block_max[b]);
+    }
+    best = std::max(best, maxOf(postings.decodeTail(doc_ids, freqs)));
+    
+    return std::nextafter(static_cast<float>(best), HUGE_VALF);
+}
+
+TopKHeap::TopKHeap(size_t k) : k(k) {}
+
+void TopKHeap::push(uint32_t doc_id, double score) {
+    ScoredDoc doc{doc_id, score};
+    if (k == 0) return;
+    
+    if (heap.size() < k) {
+        heap.push_back(doc);
+        std::push_heap(heap.begin(), heap.end(), better);
+    } else if (better(doc, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), better);
+        heap.back() = doc;
+        std::push_heap(heap.begin(), heap.end(), better);
+    }
+}
+
+std::vector<ScoredDoc> TopKHeap::take() {
+    std::sort_heap(heap.begin(), heap.end(), better);
+    std::vector<ScoredDoc> result;
+    result.swap(heap);
+    return result;
+}
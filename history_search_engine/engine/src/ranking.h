@@ -0,0 +1,59 @@
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "document_table.h"
+#include "posting_list.h"
+
+// Okapi BM25 with the usual k1 = 1.2, b = 0.75.
+class Bm25 {
+private:
+    double num_docs;
+    double avg_length;
+    
+public:
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+    
+    Bm25(size_t num_docs, double avg_length);
+    
+    double averageLength() const { return avg_length; }
+    double idf(uint32_t doc_freq) const;
+    double score(uint32_t freq, uint32_t doc_length, double idf) const;
+    // Largest score any posting of the list can get; rounded up so that it
+    // stays an upper bound after conversion to float. block_max receives the
+    // same bound for every full block.
+    float maxScore(const PostingView& postings, const DocumentTable& documents,
+                   std::vector<double>& block_max) const;
+};
+
+struct ScoredDoc {
+    uint32_t doc_id;
+    double score;
+};
+
+// Keeps the k best documents seen so far: higher score first, and the lower
+// doc ID on equal scores.
+class TopKHeap {
+private:
+    size_t k;
+    std::vector<ScoredDoc> heap;
+    
+    static bool better(const ScoredDoc& a, const ScoredDoc& b) {
+        return a.score > b.score || (a.score == b.score && a.doc_id < b.doc_id);
+    }
+    
+public:
+    explicit TopKHeap(size_t k);
+    
+    bool full() const { return heap.size() >= k; }
+    // Score a new document must exceed to enter a full heap.
+    double threshold() const { return heap.front().score; }
+    void push(uint32_t doc_id, double score);
+    // Returns the documents best first and empties the heap.
+    std::vector<ScoredDoc> take();
+};
+
+#endif
@@ -0,0 +1,480 @@
+#include "search_server.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <thread>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// How long the accept loop waits before checking for stop() and reloads.
+const int POLL_INTERVAL_MS = 500;
+
+const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        default: return "Internal Server Error";
+    }
+}
+
+void appendString(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+// Starts a member of the object or array being written at the end of out.
+void appendKey(std::string& out, const char* key) {
+    if (out.back() != '{' && out.back() != '[') out += ',';
+    appendString(out, key);
+    out += ':';
+}
+
+void addString(std::string& out, const char* key, std::string_view value) {
+    appendKey(out, key);
+    appendString(out, value);
+}
+
+void addNumber(std::string& out, const char* key, uint64_t value) {
+    appendKey(out, key);
+    out += std::to_string(value);
+}
+
+void addBool(std::string& out, const char* key, bool value) {
+    appendKey(out, key);
+    out += value ? "true" : "false";
+}
+
+void addDouble(std::string& out, const char* key, double value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.6g", value);
+    appendKey(out, key);
+    out += text;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+}
+
+SearchServer::SearchServer(const std::string& directory, const ServerOptions& options)
+    : directory(directory), options(options), listen_fd(-1),
+      connections(4 * std::max<size_t>(1, options.workers)), stopping(false), requests(0),
+      sources_generation(0) {
+    if (this->options.workers == 0) this->options.workers = 1;
+    if (this->options.max_per_page == 0) this->options.max_per_page = 1;
+    this->options.default_per_page =
+        std::min(std::max<size_t>(1, this->options.default_per_page), this->options.max_per_page);
+}
+
+SearchServer::~SearchServer() {
+    if (listen_fd >= 0) ::close(listen_fd);
+    if (!socket_path.empty()) unlink(socket_path.c_str());
+}
+
+bool SearchServer::open() {
+    // Taken first, so a commit racing with the load is picked up later.
+    loaded_version = SegmentedIndex::fileVersion(directory);
+    if (!index.open(directory)) return false;
+
+    if (index.getSegmentCount() == 0) {
+        std::cout << "No index in " << directory << " yet, serving empty results" << std::endl;
+    } else {
+        std::cout << "Loaded " << index.getLiveDocuments() << " documents in "
+                  << index.getSegmentCount() << " segment(s) from " << directory << std::endl;
+    }
+    return true;
+}
+
+void SearchServer::reloadIfChanged() {
+    std::string version = SegmentedIndex::fileVersion(directory);
+    if (version == loaded_version) return;
+
+    // A commit may be half done; the old state stays until a later try.
+    if (!index.open(directory)) return;
+    loaded_version = version;
+    std::cout << "Reloaded index: " << index.getLiveDocuments() << " documents in "
+              << index.getSegmentCount() << " segment(s)" << std::endl;
+}
+
+bool SearchServer::listenTcp(const std::string& host, uint16_t port) {
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        std::cerr << "Invalid listen address: " << host << std::endl;
+        return false;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    return listenOn(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address),
+                    host + ":" + std::to_string(port));
+}
+
+bool SearchServer::listenUnix(const std::string& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // A socket left behind by an earlier run would make bind() fail.
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (!listenOn(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address), path)) {
+        return false;
+    }
+    socket_path = path;
+    return true;
+}
+
+bool SearchServer::listenOn(int fd, const sockaddr* address, socklen_t address_size,
+                            const std::string& name) {
+    if (fd < 0 || bind(fd, address, address_size) != 0 || listen(fd, SOMAXCONN) != 0 ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) {
+        std::cerr << "Cannot listen on " << name << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    if (listen_fd >= 0) ::close(listen_fd);
+    listen_fd = fd;
+    std::cout << "Listening on " << name << " with " << options.workers << " worker(s)"
+              << std::endl;
+    return true;
+}
+
+void SearchServer::run() {
+    if (listen_fd < 0) return;
+
+    worker_cache.assign(options.workers, CacheStats());
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < options.workers; ++w) {
+        workers.emplace_back(&SearchServer::serveConnections, this, w);
+    }
+
+    auto last_check = Clock::now();
+    while (!stopping) {
+        pollfd listener = {listen_fd, POLLIN, 0};
+        if (poll(&listener, 1, POLL_INTERVAL_MS) > 0) {
+            int fd;
+            while ((fd = accept(listen_fd, nullptr, nullptr)) >= 0) {
+                // Slow clients must not hold a worker for long.
+                timeval timeout = {CLIENT_TIMEOUT_SECONDS, 0};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                connections.push(fd);
+            }
+        }
+
+        if (options.reload_seconds > 0 &&
+            Clock::now() - last_check >= std::chrono::seconds(options.reload_seconds)) {
+            reloadIfChanged();
+            last_check = Clock::now();
+        }
+    }
+
+    connections.close();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void SearchServer::serveConnections(size_t worker) {
+    BooleanSearch search(&index, options.cache_bytes);
+    int fd;
+    while (connections.pop(fd)) {
+        handleConnection(fd, search);
+        ::close(fd);
+
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        worker_cache[worker] = search.getCacheStats();
+    }
+}
+
+void SearchServer::handleConnection(int fd, BooleanSearch& search) {
+    Request request;
+    if (!readRequest(fd, request)) {
+        sendResponse(fd, error(400, "malformed request"));
+        requests++;
+        return;
+    }
+
+    // One bad query must not take the server down with it.
+    Response response;
+    try {
+        response = route(request, search);
+    } catch (const std::exception& e) {
+        std::cerr << "Request " << request.path << " failed: " << e.what() << std::endl;
+        response = error(500, "internal error");
+    }
+    sendResponse(fd, response);
+    requests++;
+}
+
+SearchServer::Response SearchServer::route(const Request& request, BooleanSearch& search) {
+    if (request.method != "GET") return error(405, "only GET is supported");
+
+    if (request.path == "/search") return searchPage(request, search);
+    if (request.path == "/stats") return stats();
+    if (request.path == "/health") return {200, "{\"status\":\"ok\"}"};
+    return error(404, "unknown path");
+}
+
+SearchServer::Response SearchServer::searchPage(const Request& request, BooleanSearch& search) {
+    auto query = request.params.find("q");
+    if (query == request.params.end() || query->second.empty()) {
+        return error(400, "missing query parameter q");
+    }
+
+    bool ranked = true;
+    auto mode = request.params.find("mode");
+    if (mode != request.params.end() && mode->second != "ranked") {
+        if (mode->second != "boolean") return error(400, "mode must be ranked or boolean");
+        ranked = false;
+    }
+    size_t page = std::max<size_t>(1, numberParam(request, "page", 1));
+    size_t per_page = std::min(options.max_per_page,
+                               std::max<size_t>(1, numberParam(request, "per_page",
+                                                               options.default_per_page)));
+
+    auto start = Clock::now();
+    // One result past the page tells whether more follow. Only then is the
+    // total estimated; counting every match would undo the pruning of
+    // ranked search.
+    size_t offset = (page - 1) * per_page;
+    std::vector<SearchResult> results =
+        ranked ? search.searchWithRanking(query->second, offset, per_page + 1)
+               : search.search(query->second, offset, per_page + 1);
+    if (!search.getQueryError().empty()) return error(400, search.getQueryError());
+    bool more = results.size() > per_page;
+    if (more) results.pop_back();
+
+    size_t total = offset + results.size();
+    bool exact = true;
+    if (more) {
+        total = std::max(total + 1, search.estimateMatches(query->second));
+        exact = false;
+    } else if (results.empty() && offset > 0) {
+        // Past the last page, which holds at most offset matches.
+        total = std::min(offset, search.estimateMatches(query->second));
+        exact = false;
+    }
+    size_t pages = (total + per_page - 1) / per_page;
+    double took_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::string body = "{";
+    addString(body, "query", query->second);
+    addString(body, "mode", ranked ? "ranked" : "boolean");
+    addNumber(body, "page", page);
+    addNumber(body, "per_page", per_page);
+    addNumber(body, "total", total);
+    addBool(body, "total_exact", exact);
+    if (!search.getQueryWarning().empty()) addString(body, "warning", search.getQueryWarning());
+    addNumber(body, "pages", pages);
+    addDouble(body, "took_ms", took_ms);
+    appendKey(body, "results");
+    body += '[';
+    for (const auto& result : results) {
+        if (body.back() != '[') body += ',';
+        body += '{';
+        addString(body, "url", result.url);
+        addString(body, "source", result.source);
+        addDouble(body, "score", result.relevance_score);
+        body += '}';
+    }
+    body += "]}";
+    return {200, std::move(body)};
+}
+
+SearchServer::Response SearchServer::stats() {
+    IndexSnapshot snapshot = index.snapshot();
+
+    std::string body = "{";
+    addNumber(body, "documents", index.getLiveDocuments());
+    addNumber(body, "deleted", index.getDeletedDocuments());
+    addNumber(body, "segments", index.getSegmentCount());
+    addNumber(body, "generation", snapshot.generation);
+    addNumber(body, "workers", options.workers);
+    addNumber(body, "requests", requests);
+
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    if (sources_generation != snapshot.generation) {
+        source_counts.clear();
+        for (const auto& segment : snapshot.segments) {
+            uint32_t num_docs = static_cast<uint32_t>(segment.index->getTotalDocuments());
+            for (uint32_t doc = 0; doc < num_docs; ++doc) {
+                if (segment.deleted && segment.deleted->test(doc)) continue;
+                source_counts[segment.index->getSource(doc)]++;
+            }
+        }
+        sources_generation = snapshot.generation;
+    }
+    appendKey(body, "sources");
+    body += '[';
+    for (const auto& entry : source_counts) {
+        if (body.back() != '[') body += ',';
+        body += '{';
+        addString(body, "source", entry.first);
+        addNumber(body, "documents", entry.second);
+        body += '}';
+    }
+    body += ']';
+
+    CacheStats cache;
+    for (const auto& worker : worker_cache) {
+        cache.hits += worker.hits;
+        cache.misses += worker.misses;
+        cache.evictions += worker.evictions;
+        cache.invalidations += worker.invalidations;
+        cache.entries += worker.entries;
+        cache.bytes += worker.bytes;
+        cache.capacity += worker.capacity;
+    }
+    appendKey(body, "cache");
+    body += '{';
+    addNumber(body, "hits", cache.hits);
+    addNumber(body, "misses", cache.misses);
+    addNumber(body, "evictions", cache.evictions);
+    addNumber(body, "invalidations", cache.invalidations);
+    addNumber(body, "entries", cache.entries);
+    addNumber(body, "bytes", cache.bytes);
+    addNumber(body, "capacity", cache.capacity);
+    body += "}}";
+    return {200, std::move(body)};
+}
+
+bool SearchServer::readRequest(int fd, Request& request) {
+    std::string data;
+    char buffer[4096];
+    size_t header_end;
+    while ((header_end = data.find("\r\n\r\n")) == std::string::npos) {
+        if (data.size() >= MAX_REQUEST_BYTES) return false;
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        data.append(buffer, static_cast<size_t>(received));
+    }
+
+    // Request line: METHOD TARGET VERSION. Headers and body are ignored.
+    std::string_view line(data.data(), data.find("\r\n"));
+    size_t method_end = line.find(' ');
+    if (method_end == std::string_view::npos) return false;
+    size_t target_end = line.find(' ', method_end + 1);
+    if (target_end == std::string_view::npos) return false;
+
+    request.method = std::string(line.substr(0, method_end));
+    std::string_view target = line.substr(method_end + 1, target_end - method_end - 1);
+    size_t question = target.find('?');
+    request.path = decode(target.substr(0, question));
+    if (question != std::string_view::npos) {
+        parseQueryString(target.substr(question + 1), request);
+    }
+    return true;
+}
+
+void SearchServer::parseQueryString(std::string_view query, Request& request) {
+    while (!query.empty()) {
+        size_t end = query.find('&');
+        std::string_view pair = query.substr(0, end);
+        size_t equals = pair.find('=');
+        std::string name = decode(pair.substr(0, equals));
+        std::string value = equals == std::string_view::npos ? "" : decode(pair.substr(equals + 1));
+        if (!name.empty()) request.params[name] = std::move(value);
+        if (end == std::string_view::npos) break;
+        query.remove_prefix(end + 1);
+    }
+}
+
+size_t SearchServer::numberParam(const Request& request, const char* name, size_t fallback) {
+    auto it = request.params.find(name);
+    if (it == request.params.end()) return fallback;
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(it->second.c_str(), &end, 10);
+    if (it->second.empty() || *end != '\0') return fallback;
+    return static_cast<size_t>(value);
+}
+
+std::string SearchServer::decode(std::string_view text) {
+    std::string decoded;
+    decoded.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '+') {
+            decoded += ' ';
+        } else if (text[i] == '%' && i + 2 < text.size() &&
+                   hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+            decoded += static_cast<char>(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2]));
+            i += 2;
+        } else {
+            decoded += text[i];
+        }
+    }
+    return decoded;
+}
+
+void SearchServer::sendResponse(int fd, const Response& response) {
+    std::string data = "HTTP/1.1 " + std::to_string(response.status) + ' ' +
+                       statusText(response.status) + "\r\n"
+                       "Content-Type: application/json; charset=utf-8\r\n"
+                       "Content-Length: " + std::to_string(response.body.size()) + "\r\n"
+                       "Connection: close\r\n\r\n";
+    data += response.body;
+
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t written = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return;
+        sent += static_cast<size_t>(written);
+    }
+}
+
+SearchServer::Response SearchServer::error(int status, std::string_view message) {
+    std::string body = "{";
+    addString(body, "error", message);
+    body += '}';
+    return {status, std::move(body)};
+}
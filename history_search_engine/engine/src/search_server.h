@@ -0,0 +1,107 @@
+#ifndef SEARCH_SERVER_H
+#define SEARCH_SERVER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include "boolean_search.h"
+#include "bounded_queue.h"
+#include "lru_cache.h"
+#include "segmented_index.h"
+
+struct ServerOptions {
+    size_t workers = 4;
+    // Result cache of each worker.
+    size_t cache_bytes = BooleanSearch::DEFAULT_CACHE_BYTES;
+    size_t default_per_page = 10;
+    size_t max_per_page = 100;
+    // How often to look for a newer index on disk; 0 never reloads.
+    unsigned reload_seconds = 10;
+};
+
+// Serves an index directory over HTTP, on TCP or a Unix socket, from
+// memory: the segments are mapped once and shared by a pool of workers,
+// each with its own BooleanSearch and result cache. One thread accepts
+// connections and hands them to the workers through a bounded queue; it
+// also reopens the index when another process commits to it, without
+// disturbing queries running on the previous snapshot.
+//
+//   GET /search?q=QUERY[&page=N][&per_page=N][&mode=ranked|boolean]
+//   GET /stats
+//   GET /health
+//
+// Answers are JSON, one request per connection. /search reports an
+// estimated total, with total_exact false, unless the last page is reached,
+// and a warning when phrases or NEAR could not be checked on positions. The server only reads the
+// directory; updates and merges are left to the indexer.
+class SearchServer {
+private:
+    struct Request {
+        std::string method;
+        std::string path;
+        std::unordered_map<std::string, std::string> params;
+    };
+
+    struct Response {
+        int status;
+        std::string body;
+    };
+
+    std::string directory;
+    ServerOptions options;
+    SegmentedIndex index;
+    std::string loaded_version;
+    int listen_fd;
+    std::string socket_path;
+    BoundedQueue<int> connections;
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> requests;
+
+    std::mutex stats_mutex;
+    std::vector<CacheStats> worker_cache;
+    // Live documents per source, counted once per index generation.
+    std::map<std::string, size_t> source_counts;
+    uint64_t sources_generation;
+
+    bool listenOn(int fd, const sockaddr* address, socklen_t address_size,
+                  const std::string& name);
+    void reloadIfChanged();
+    void serveConnections(size_t worker);
+    void handleConnection(int fd, BooleanSearch& search);
+    Response route(const Request& request, BooleanSearch& search);
+    Response searchPage(const Request& request, BooleanSearch& search);
+    Response stats();
+
+    static bool readRequest(int fd, Request& request);
+    static void parseQueryString(std::string_view query, Request& request);
+    static size_t numberParam(const Request& request, const char* name, size_t fallback);
+    static std::string decode(std::string_view text);
+    static void sendResponse(int fd, const Response& response);
+    static Response error(int status, std::string_view message);
+
+public:
+    static const size_t MAX_REQUEST_BYTES = 16 * 1024;
+    static const int CLIENT_TIMEOUT_SECONDS = 5;
+
+    explicit SearchServer(const std::string& directory,
+                          const ServerOptions& options = ServerOptions());
+    ~SearchServer();
+    SearchServer(const SearchServer&) = delete;
+    SearchServer& operator=(const SearchServer&) = delete;
+
+    bool open();
+    bool listenTcp(const std::string& host, uint16_t port);
+    bool listenUnix(const std::string& path);
+    // Serves until stop(), which is safe to call from a signal handler.
+    void run();
+    void stop() { stopping = true; }
+};
+
+#endif
@@ -0,0 +1,446 @@
+#include "segmented_index.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+
+namespace {
+
+const char* const MANIFEST = "segments.manifest";
+const char* const MANIFEST_MAGIC = "HSE-SEGMENTS";
+const int MANIFEST_VERSION = 1;
+const char* const BASE_SEGMENT = "inverted_index.bin";
+const char* const NO_DELETES = "-";
+
+struct ManifestEntry {
+    std::string file;
+    std::string deletes_file;
+};
+
+// Manifest format, one item per line:
+//   HSE-SEGMENTS <version>
+//   next <next file id>
+//   <segment file> <tombstone file or ->     (oldest segment first)
+bool readManifest(std::istream& in, uint64_t& next_file_id, std::vector<ManifestEntry>& entries) {
+    std::string magic, key;
+    int version = 0;
+    if (!(in >> magic >> version) || magic != MANIFEST_MAGIC || version != MANIFEST_VERSION) {
+        return false;
+    }
+    if (!(in >> key >> next_file_id) || key != "next") return false;
+
+    ManifestEntry entry;
+    while (in >> entry.file >> entry.deletes_file) {
+        if (entry.deletes_file == NO_DELETES) entry.deletes_file.clear();
+        entries.push_back(entry);
+    }
+    return in.eof();
+}
+
+bool fileExists(const std::string& path) {
+    return static_cast<bool>(std::ifstream(path));
+}
+
+// Files are replaced by rename(), which gives them a new inode.
+std::string fileStamp(const std::string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return "-";
+    return std::to_string(info.st_ino) + ':' + std::to_string(info.st_size) + ':' +
+           std::to_string(info.st_mtim.tv_sec) + '.' + std::to_string(info.st_mtim.tv_nsec);
+}
+
+}
+
+size_t IndexSnapshot::segmentOf(uint32_t doc_id) const {
+    auto it = std::upper_bound(segments.begin(), segments.end(), doc_id,
+                               [](uint32_t id, const SegmentView& segment) {
+                                   return id < segment.base;
+                               });
+    return static_cast<size_t>(it - segments.begin()) - 1;
+}
+
+SegmentedIndex::SegmentedIndex(const MergePolicy& policy)
+    : policy(policy), state(std::make_shared<State>()), next_file_id(1) {
+    if (this->policy.floor_docs == 0) this->policy.floor_docs = 1;
+    if (this->policy.merge_factor < 2) this->policy.merge_factor = 2;
+}
+
+std::string SegmentedIndex::path(const std::string& file) const {
+    return directory + "/" + file;
+}
+
+std::string SegmentedIndex::newFileName(const char* prefix, const char* extension) {
+    return prefix + std::to_string(next_file_id++) + extension;
+}
+
+std::shared_ptr<const SegmentedIndex::State> SegmentedIndex::current() const {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    return state;
+}
+
+bool SegmentedIndex::open(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(commit_mutex);
+    directory = dir;
+
+    std::vector<Segment> segments;
+    std::ifstream manifest(path(MANIFEST));
+    if (manifest) {
+        uint64_t next_id = 0;
+        std::vector<ManifestEntry> entries;
+        if (!readManifest(manifest, next_id, entries)) {
+            std::cerr << "Corrupted segment manifest: " << path(MANIFEST) << std::endl;
+            return false;
+        }
+        next_file_id = next_id;
+        for (const auto& entry : entries) {
+            Segment segment;
+            if (!loadSegment(entry.file, entry.deletes_file, segment)) return false;
+            segments.push_back(std::move(segment));
+        }
+    } else if (fileExists(path(BASE_SEGMENT))) {
+        Segment segment;
+        if (!loadSegment(BASE_SEGMENT, "", segment)) return false;
+        segments.push_back(std::move(segment));
+    }
+
+    auto next = std::make_shared<State>();
+    next->segments = std::move(segments);
+    std::lock_guard<std::mutex> state_lock(state_mutex);
+    next->generation = state->generation + 1;
+    state = std::move(next);
+    return true;
+}
+
+void SegmentedIndex::clear(const std::string& directory) {
+    std::string manifest_path = directory + "/" + MANIFEST;
+    std::ifstream manifest(manifest_path);
+    if (!manifest) return;
+
+    uint64_t next_id = 0;
+    std::vector<ManifestEntry> entries;
+    readManifest(manifest, next_id, entries);
+    manifest.close();
+
+    // The rebuild overwrites the base segment itself.
+    for (const auto& entry : entries) {
+        if (entry.file != BASE_SEGMENT) std::remove((directory + "/" + entry.file).c_str());
+        if (!entry.deletes_file.empty()) {
+            std::remove((directory + "/" + entry.deletes_file).c_str());
+        }
+    }
+    std::remove(manifest_path.c_str());
+}
+
+std::string SegmentedIndex::fileVersion(const std::string& directory) {
+    return fileStamp(directory + "/" + MANIFEST) + ' ' + fileStamp(directory + "/" + BASE_SEGMENT);
+}
+
+bool SegmentedIndex::loadSegment(const std::string& file, const std::string& deletes_file,
+                                 Segment& segment) {
+    auto index = std::make_shared<InvertedIndex>();
+    if (!index->loadFromFile(path(file))) return false;
+
+    segment.file = file;
+    segment.deletes_file = deletes_file;
+    segment.index = index;
+    segment.deleted = nullptr;
+    segment.deleted_count = 0;
+    if (deletes_file.empty()) return true;
+
+    std::ifstream in(path(deletes_file), std::ios::binary);
+    auto deleted = std::make_shared<DocBitmap>();
+    if (!in || !deleted->load(in) || deleted->size() != index->getTotalDocuments()) {
+        std::cerr << "Corrupted tombstone file: " << path(deletes_file) << std::endl;
+        return false;
+    }
+    segment.deleted_count = deleted->count();
+    segment.deleted = std::move(deleted);
+    return true;
+}
+
+bool SegmentedIndex::saveDeletes(Segment& segment, DocBitmap deleted) {
+    std::string file = newFileName("deletes_", ".del");
+    std::ofstream out(path(file), std::ios::binary);
+    deleted.save(out);
+    out.flush();
+    if (!out) {
+        std::cerr << "Failed to write tombstone file: " << path(file) << std::endl;
+        return false;
+    }
+
+    segment.deletes_file = file;
+    segment.deleted_count = deleted.count();
+    segment.deleted = std::make_shared<DocBitmap>(std::move(deleted));
+    return true;
+}
+
+bool SegmentedIndex::writeManifest(const std::vector<Segment>& segments) const {
+    std::string target = path(MANIFEST);
+    std::string temp = target + ".tmp";
+    {
+        std::ofstream out(temp);
+        out << MANIFEST_MAGIC << ' ' << MANIFEST_VERSION << '\n';
+        out << "next " << next_file_id << '\n';
+        for (const auto& segment : segments) {
+            out << segment.file << ' '
+                << (segment.deletes_file.empty() ? NO_DELETES : segment.deletes_file) << '\n';
+        }
+        out.flush();
+        if (!out) {
+            std::cerr << "Failed to write segment manifest: " << temp << std::endl;
+            return false;
+        }
+    }
+
+    // rename() replaces the old manifest atomically.
+    if (std::rename(temp.c_str(), target.c_str()) != 0) {
+        std::cerr << "Failed to replace segment manifest: " << target << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SegmentedIndex::publish(std::vector<Segment> segments,
+                             const std::vector<std::string>& obsolete) {
+    if (!writeManifest(segments)) return false;
+
+    auto next = std::make_shared<State>();
+    next->segments = std::move(segments);
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        next->generation = state->generation + 1;
+        state = std::move(next);
+    }
+
+    // Snapshots still using these files keep their mappings.
+    for (const auto& file : obsolete) {
+        std::remove(path(file).c_str());
+    }
+    return true;
+}
+
+bool SegmentedIndex::markDeleted(std::vector<Segment>& segments, const HashTable<uint32_t>& urls,
+                                 std::vector<std::string>& obsolete, size_t& marked) {
+    for (auto& segment : segments) {
+        const DocBitmap* old = segment.deleted.get();
+        std::unique_ptr<DocBitmap> deleted;
+
+        segment.index->getDocuments().forEachUrl([&](uint32_t doc_id, std::string_view url) {
+            if ((old && old->test(doc_id)) || !urls.get(url)) return;
+            if (!deleted) {
+                deleted = old ? std::make_unique<DocBitmap>(*old)
+                              : std::make_unique<DocBitmap>(segment.index->getTotalDocuments());
+            }
+            deleted->set(doc_id);
+        });
+        if (!deleted) continue;
+
+        std::string replaced = segment.deletes_file;
+        size_t before = segment.deleted_count;
+        if (!saveDeletes(segment, std::move(*deleted))) return false;
+        marked += segment.deleted_count - before;
+        if (!replaced.empty()) obsolete.push_back(replaced);
+    }
+    return true;
+}
+
+bool SegmentedIndex::addSegment(InvertedIndex& built) {
+    if (built.getTotalDocuments() == 0) return false;
+
+    std::lock_guard<std::mutex> lock(commit_mutex);
+    std::string file = newFileName("segment_", ".bin");
+    Segment added;
+    if (!built.saveToFile(path(file)) || !loadSegment(file, "", added)) {
+        std::remove(path(file).c_str());
+        return false;
+    }
+
+    // The last copy of a URL wins, within the new segment as well.
+    HashTable<uint32_t> urls;
+    DocBitmap replaced(static_cast<uint32_t>(added.index->getTotalDocuments()));
+    bool has_replaced = false;
+    added.index->getDocuments().forEachUrl([&](uint32_t doc_id, std::string_view url) {
+        auto slot = urls.try_emplace(url, doc_id);
+        if (!slot.second) {
+            replaced.set(*slot.first);
+            *slot.first = doc_id;
+            has_replaced = true;
+        }
+    });
+
+    std::vector<Segment> segments = current()->segments;
+    std::vector<std::string> obsolete;
+    size_t marked = 0;
+    if (!markDeleted(segments, urls, obsolete, marked) ||
+        (has_replaced && !saveDeletes(added, std::move(replaced)))) {
+        return false;
+    }
+    segments.push_back(std::move(added));
+    return publish(std::move(segments), obsolete);
+}
+
+size_t SegmentedIndex::remove(const std::vector<std::string>& urls) {
+    HashTable<uint32_t> targets;
+    for (const auto& url : urls) {
+        targets.try_emplace(std::string_view(url), 0u);
+    }
+
+    std::lock_guard<std::mutex> lock(commit_mutex);
+    std::vector<Segment> segments = current()->segments;
+    std::vector<std::string> obsolete;
+    size_t marked = 0;
+    if (!markDeleted(segments, targets, obsolete, marked) || marked == 0) return 0;
+    if (!publish(std::move(segments), obsolete)) return 0;
+    return marked;
+}
+
+size_t SegmentedIndex::tierOf(size_t live_docs) const {
+    size_t tier = 0;
+    for (size_t bound = policy.floor_docs; live_docs > bound; bound *= policy.merge_factor) {
+        tier++;
+    }
+    return tier;
+}
+
+bool SegmentedIndex::findMerge(const State& snapshot, size_t& first, size_t& count) const {
+    const auto& segments = snapshot.segments;
+
+    for (size_t i = 0; i + policy.merge_factor <= segments.size(); ++i) {
+        size_t tier = tierOf(segments[i].liveDocuments());
+        size_t end = i + 1;
+        while (end < i + policy.merge_factor && tierOf(segments[end].liveDocuments()) == tier) {
+            ++end;
+        }
+        if (end == i + policy.merge_factor) {
+            first = i;
+            count = policy.merge_factor;
+            return true;
+        }
+    }
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const Segment& segment = segments[i];
+        if (segment.deleted_count > 0 &&
+            segment.deleted_count > policy.max_deleted_ratio * segment.index->getTotalDocuments()) {
+            first = i;
+            count = 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SegmentedIndex::mergeOnce() {
+    std::lock_guard<std::mutex> merge_lock(merge_mutex);
+    std::shared_ptr<const State> before = current();
+    size_t first = 0;
+    size_t count = 0;
+    if (!findMerge(*before, first, count)) return false;
+
+    // The expensive part runs without blocking commits.
+    InvertedIndex merged;
+    bool positions = true;
+    for (size_t i = first; i < first + count; ++i) {
+        positions = positions && before->segments[i].index->storesPositions();
+    }
+    merged.setStorePositions(positions);
+
+    std::vector<std::vector<uint32_t>> new_ids;
+    for (size_t i = first; i < first + count; ++i) {
+        const Segment& source = before->segments[i];
+        new_ids.push_back(merged.appendLive(*source.index, source.deleted.get()));
+    }
+
+    Segment result;
+    bool empty = merged.getTotalDocuments() == 0;
+    if (!empty) {
+        std::string file = newFileName("segment_", ".bin");
+        if (!merged.saveToFile(path(file)) || !loadSegment(file, "", result)) {
+            std::remove(path(file).c_str());
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(commit_mutex);
+    std::vector<Segment> segments = current()->segments;
+    // Commits only append segments and replace tombstones, and merges are
+    // serialized, so the sources are still in place.
+    for (size_t i = 0; i < count; ++i) {
+        if (segments[first + i].index != before->segments[first + i].index) {
+            if (!empty) std::remove(path(result.file).c_str());
+            return false;
+        }
+    }
+
+    // Tombstones committed during the merge move to the merged segment.
+    DocBitmap deleted(static_cast<uint32_t>(empty ? 0 : result.index->getTotalDocuments()));
+    bool has_deleted = false;
+    std::vector<std::string> obsolete;
+    for (size_t i = 0; i < count; ++i) {
+        const Segment& source = segments[first + i];
+        obsolete.push_back(source.file);
+        if (!source.deletes_file.empty()) obsolete.push_back(source.deletes_file);
+        if (empty || !source.deleted || source.deleted == before->segments[first + i].deleted) {
+            continue;
+        }
+
+        for (uint32_t doc = source.deleted->nextSet(0); doc != DocBitmap::END;
+             doc = source.deleted->nextSet(doc + 1)) {
+            if (new_ids[i][doc] != InvertedIndex::DROPPED) {
+                deleted.set(new_ids[i][doc]);
+                has_deleted = true;
+            }
+        }
+    }
+    if (has_deleted && !saveDeletes(result, std::move(deleted))) return false;
+
+    segments.erase(segments.begin() + first, segments.begin() + first + count);
+    if (!empty) {
+        segments.insert(segments.begin() + first, std::move(result));
+    }
+    return publish(std::move(segments), obsolete);
+}
+
+void SegmentedIndex::mergePending() {
+    while (mergeOnce()) {
+    }
+}
+
+IndexSnapshot SegmentedIndex::snapshot() const {
+    std::shared_ptr<const State> now = current();
+
+    IndexSnapshot snapshot;
+    snapshot.generation = now->generation;
+    for (const auto& segment : now->segments) {
+        snapshot.segments.push_back({segment.index.get(), segment.deleted.get(),
+                                     static_cast<uint32_t>(snapshot.total_docs)});
+        snapshot.total_docs += segment.index->getTotalDocuments();
+    }
+    snapshot.owner = std::move(now);
+    return snapshot;
+}
+
+uint64_t SegmentedIndex::getGeneration() const {
+    return current()->generation;
+}
+
+size_t SegmentedIndex::getSegmentCount() const {
+    return current()->segments.size();
+}
+
+size_t SegmentedIndex::getLiveDocuments() const {
+    size_t live = 0;
+    for (const auto& segment : current()->segments) {
+        live += segment.liveDocuments();
+    }
+    return live;
+}
+
+size_t SegmentedIndex::getDeletedDocuments() const {
+    size_t deleted = 0;
+    for (const auto& segment : current()->segments) {
+        deleted += segment.deleted_count;
+    }
+    return deleted;
+}
@@ -0,0 +1,140 @@
+#ifndef SEGMENTED_INDEX_H
+#define SEGMENTED_INDEX_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "doc_bitmap.h"
+#include "hash_table.h"
+#include "inverted_index.h"
+
+// One segment as seen by a query. Doc IDs of the segment are numbered from
+// `base` in the global doc ID space; `deleted` (or null) marks tombstones.
+struct SegmentView {
+    const InvertedIndex* index;
+    const DocBitmap* deleted;
+    uint32_t base;
+};
+
+// Segments of one committed state, oldest first. `owner` keeps them alive
+// while the snapshot is in use, however the index changes meanwhile.
+struct IndexSnapshot {
+    std::vector<SegmentView> segments;
+    std::shared_ptr<const void> owner;
+    uint64_t generation = 0;
+    size_t total_docs = 0;
+
+    // Position in `segments` of the segment holding global doc_id.
+    size_t segmentOf(uint32_t doc_id) const;
+};
+
+// Tiered merging: a segment's tier is log_merge_factor(live docs /
+// floor_docs), and merge_factor adjacent segments of one tier are merged
+// into one of the next tier. A segment with more than max_deleted_ratio of
+// its documents deleted is rewritten on its own to drop them.
+struct MergePolicy {
+    size_t floor_docs = 1000;
+    size_t merge_factor = 4;
+    double max_deleted_ratio = 0.5;
+};
+
+// Index made of immutable, memory-mapped segments in one directory.
+// Updates never touch a segment file: new and changed documents go into a
+// new segment, and older copies of their URLs, like removed URLs, are
+// marked in a per-segment tombstone bitmap stored next to it. The list of
+// segments and tombstone files is the manifest, "segments.manifest",
+// replaced atomically on every commit; a directory without a manifest is
+// opened as the single segment inverted_index.bin.
+//
+// Readers take a snapshot() and never block commits; commits and merges
+// build the new state aside and publish it under a short lock. Merges run
+// synchronously in mergePending(), which the indexer calls after every
+// update; readers keep querying the old segments meanwhile.
+class SegmentedIndex {
+private:
+    struct Segment {
+        std::string file;
+        // Empty if nothing is deleted.
+        std::string deletes_file;
+        std::shared_ptr<const InvertedIndex> index;
+        std::shared_ptr<const DocBitmap> deleted;
+        size_t deleted_count = 0;
+
+        size_t liveDocuments() const { return index->getTotalDocuments() - deleted_count; }
+    };
+
+    struct State {
+        std::vector<Segment> segments;
+        uint64_t generation = 0;
+    };
+
+    std::string directory;
+    MergePolicy policy;
+    std::shared_ptr<const State> state;
+    mutable std::mutex state_mutex;
+    std::mutex commit_mutex;
+    // Numbers new segment and tombstone files.
+    std::atomic<uint64_t> next_file_id;
+    // Serializes merges, which build the merged segment outside commit_mutex.
+    std::mutex merge_mutex;
+
+    std::shared_ptr<const State> current() const;
+    // Writes the manifest for segments and makes them the current state,
+    // then deletes the files in obsolete. Requires commit_mutex.
+    bool publish(std::vector<Segment> segments, const std::vector<std::string>& obsolete);
+    bool writeManifest(const std::vector<Segment>& segments) const;
+    std::string path(const std::string& file) const;
+    std::string newFileName(const char* prefix, const char* extension);
+
+    bool loadSegment(const std::string& file, const std::string& deletes_file, Segment& segment);
+    // Writes deleted as a new tombstone file of the segment.
+    bool saveDeletes(Segment& segment, DocBitmap deleted);
+    // Tombstones the live documents of segments whose URL is in urls and
+    // adds their number to marked. Changed segments get new tombstone
+    // files; the replaced ones are added to obsolete.
+    bool markDeleted(std::vector<Segment>& segments, const HashTable<uint32_t>& urls,
+                     std::vector<std::string>& obsolete, size_t& marked);
+
+    size_t tierOf(size_t live_docs) const;
+    // Range of segments the policy wants merged next; false if none.
+    bool findMerge(const State& snapshot, size_t& first, size_t& count) const;
+    bool mergeOnce();
+
+public:
+    explicit SegmentedIndex(const MergePolicy& policy = MergePolicy());
+    SegmentedIndex(const SegmentedIndex&) = delete;
+    SegmentedIndex& operator=(const SegmentedIndex&) = delete;
+
+    bool open(const std::string& directory);
+    // Forgets the segments of a directory before a full rebuild writes its
+    // inverted_index.bin: deletes the manifest and every file it lists.
+    static void clear(const std::string& directory);
+    // Identifies the files open() would load from a directory; it changes
+    // whenever a commit, merge or rebuild replaces them, so processes that
+    // only read can tell when to open() again.
+    static std::string fileVersion(const std::string& directory);
+
+    // Commits the documents of a freshly built index as a new segment.
+    // Documents with the same URL in older segments, or earlier in the
+    // index itself, are tombstoned. Returns false if nothing was committed.
+    bool addSegment(InvertedIndex& built);
+    // Tombstones every live document with one of these URLs and returns
+    // their number.
+    size_t remove(const std::vector<std::string>& urls);
+
+    // Runs merges until the policy finds nothing to merge.
+    void mergePending();
+
+    IndexSnapshot snapshot() const;
+    uint64_t getGeneration() const;
+    size_t getSegmentCount() const;
+    size_t getLiveDocuments() const;
+    size_t getDeletedDocuments() const;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "search_server.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+static SearchServer* running_server = nullptr;
+
+static void handleSignal(int) {
+    if (running_server) running_server->stop();
+}
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --index DIR     directory of the index to serve (default: /app/output)\n"
+              << "  --host ADDR     IPv4 address to listen on (default: 0.0.0.0)\n"
+              << "  --port N        TCP port (default: 8080)\n"
+              << "  --socket PATH   listen on a Unix socket instead of TCP\n"
+              << "  --threads N     number of worker threads (default: CPU count)\n"
+              << "  --cache-mb MB   result cache of each worker (default: 32)\n"
+              << "  --reload-interval SEC\n"
+              << "                  check for a newer index every SEC seconds, 0 to\n"
+              << "                  never reload (default: 10)\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::string index_dir = "/app/output";
+    std::string host = "0.0.0.0";
+    std::string socket_path;
+    int port = 8080;
+    ServerOptions options;
+    options.workers = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (arg == "--index" && i + 1 < argc) {
+            index_dir = argv[++i];
+        } else if (arg == "--host" && i + 1 < argc) {
+            host = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            port = std::atoi(argv[++i]);
+        } else if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.workers = std::strtoul(argv[++i], nullptr, 10);
+            if (options.workers == 0) options.workers = 1;
+        } else if (arg == "--cache-mb" && i + 1 < argc) {
+            options.cache_bytes = std::strtoul(argv[++i], nullptr, 10) * 1024 * 1024;
+        } else if (arg == "--reload-interval" && i + 1 < argc) {
+            options.reload_seconds = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (port <= 0 || port > 65535) {
+        std::cerr << "Invalid port: " << port << std::endl;
+        return 1;
+    }
+
+    SearchServer server(index_dir, options);
+    if (!server.open()) {
+        return 1;
+    }
+    bool listening = socket_path.empty()
+        ? server.listenTcp(host, static_cast<uint16_t>(port))
+        : server.listenUnix(socket_path);
+    if (!listening) {
+        return 1;
+    }
+
+    running_server = &server;
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+    server.run();
+    running_server = nullptr;
+
+    std::cout << "Server stopped" << std::endl;
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "set_operations.h"
+#include <algorithm>
+
+// x86-64 always has SSE2. The AVX2 kernel is compiled for that target on
+// its own and only called when the CPU reports AVX2, so the build needs no
+// -mavx2 and the binary still runs on older CPUs.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SET_OPERATIONS_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// The block kernels below advance i, j and k over whole groups of elements.
+// Matches are written branch-free: every lane is stored and k advances by
+// the match bit. The loops stop while a full group of stores still fits in
+// the `capacity` of the output, and the scalar merge finishes the tails.
+
+#if defined(SET_OPERATIONS_AVX2)
+bool cpuHasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+// Compares 8 elements of a against all 8 rotations of 8 elements of b.
+__attribute__((target("avx2")))
+void intersectAvx2(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                   uint32_t* out, size_t capacity, size_t& i, size_t& j, size_t& k) {
+    const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    while (i + 8 <= na && j + 8 <= nb && k + 8 <= capacity) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        
+        __m256i match = _mm256_cmpeq_epi32(va, vb);
+        for (int r = 1; r < 8; ++r) {
+            vb = _mm256_permutevar8x32_epi32(vb, rotate);
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi32(va, vb));
+        }
+        
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(match)));
+        for (int lane = 0; lane < 8; ++lane) {
+            out[k] = a[i + lane];
+            k += (mask >> lane) & 1;
+        }
+        
+        uint32_t last_a = a[i + 7];
+        uint32_t last_b = b[j + 7];
+        i += last_a <= last_b ? 8 : 0;
+        j += last_b <= last_a ? 8 : 0;
+    }
+}
+#endif
+
+#if defined(SET_OPERATIONS_AVX2) || defined(__SSE2__)
+// Compares 4 elements of a against all 4 rotations of 4 elements of b.
+void intersectSse2(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                   uint32_t* out, size_t capacity, size_t& i, size_t& j, size_t& k) {
+    while (i + 4 <= na && j + 4 <= nb && k + 4 <= capacity) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+        
+        __m128i match = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4E)),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93))));
+        
+        unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(match)));
+        for (int lane = 0; lane < 4; ++lane) {
+            out[k] = a[i + lane];
+            k += (mask >> lane) & 1;
+        }
+        
+        uint32_t last_a = a[i + 3];
+        uint32_t last_b = b[j + 3];
+        i += last_a <= last_b ? 4 : 0;
+        j += last_b <= last_a ? 4 : 0;
+    }
+}
+#endif
+
+}
+
+size_t SetOperations::gallop(const uint32_t* data, size_t from, size_t n, uint32_t target) {
+    if (from >= n || data[from] >= target) return from;
+    
+    size_t lo = from;
+    size_t step = 1;
+    size_t hi = from + 1;
+    while (hi < n && data[hi] < target) {
+        lo = hi;
+        step *= 2;
+        hi = from + step;
+    }
+    hi = std::min(hi, n);
+    
+    return std::lower_bound(data + lo + 1, data + hi, target) - data;
+}
+
+size_t SetOperations::intersectScalar(const uint32_t* a, size_t na,
+                                      const uint32_t* b, size_t nb, uint32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        uint32_t x = a[i];
+        uint32_t y = b[j];
+        out[k] = x;
+        k += x == y;
+        i += x <= y;
+        j += y <= x;
+    }
+    return k;
+}
+
+size_t SetOperations::intersectGalloping(const uint32_t* small, size_t n_small,
+                                         const uint32_t* large, size_t n_large, uint32_t* out) {
+    size_t k = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < n_small && j < n_large; ++i) {
+        j = gallop(large, j, n_large, small[i]);
+        if (j < n_large && large[j] == small[i]) {
+            out[k++] = small[i];
+            ++j;
+        }
+    }
+    return k;
+}
+
+size_t SetOperations::intersectSimd(const uint32_t* a, size_t na,
+                                    const uint32_t* b, size_t nb, uint32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    const size_t capacity = std::min(na, nb);
+    
+#if defined(SET_OPERATIONS_AVX2)
+    if (cpuHasAvx2()) {
+        intersectAvx2(a, na, b, nb, out, capacity, i, j, k);
+    } else {
+        intersectSse2(a, na, b, nb, out, capacity, i, j, k);
+    }
+#elif defined(__SSE2__)
+    intersectSse2(a, na, b, nb, out, capacity, i, j, k);
+#endif
+    
+    return k + intersectScalar(a + i, na - i, b + j, nb - j, out + k);
+}
+
+size_t SetOperations::intersect(const uint32_t* a, size_t na,
+                                const uint32_t* b, size_t nb, uint32_t* out) {
+    if (na == 0 || nb == 0) return 0;
+    
+    if (na * GALLOP_RATIO < nb) return intersectGalloping(a, na, b, nb, out);
+    if (nb * GALLOP_RATIO < na) return intersectGalloping(b, nb, a, na, out);
+    return intersectSimd(a, na, b, nb, out);
+}
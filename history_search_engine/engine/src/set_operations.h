@@ -0,0 +1,33 @@
+#ifndef SET_OPERATIONS_H
+#define SET_OPERATIONS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Intersection kernels over strictly increasing uint32_t arrays. Every
+// kernel writes into a caller-provided buffer of min(na, nb) elements and
+// returns the number of elements written. intersect picks an algorithm from
+// the size ratio: galloping (exponential search in the longer input) when
+// the sizes are skewed, otherwise a SIMD block kernel or a scalar merge.
+// On x86-64 the block kernel is AVX2 if the CPU supports it, checked once
+// at run time, and SSE2 otherwise.
+class SetOperations {
+public:
+    static const size_t GALLOP_RATIO = 32;
+
+    static size_t intersect(const uint32_t* a, size_t na,
+                            const uint32_t* b, size_t nb, uint32_t* out);
+
+    static size_t intersectScalar(const uint32_t* a, size_t na,
+                                  const uint32_t* b, size_t nb, uint32_t* out);
+    static size_t intersectGalloping(const uint32_t* small, size_t n_small,
+                                     const uint32_t* large, size_t n_large, uint32_t* out);
+    static size_t intersectSimd(const uint32_t* a, size_t na,
+                                const uint32_t* b, size_t nb, uint32_t* out);
+
+    // Index of the first element >= target in [from, n), found by doubling
+    // the step from `from` and then binary searching the last interval.
+    static size_t gallop(const uint32_t* data, size_t from, size_t n, uint32_t target);
+};
+
+#endif
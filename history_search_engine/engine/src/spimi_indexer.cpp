@@ -0,0 +1,204 @@
+#include "spimi_indexer.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <functional>
+#include <queue>
+
+namespace {
+
+struct RunReader {
+    std::ifstream in;
+    size_t remaining;
+    std::string term;
+    PostingList postings;
+    
+    bool open(const std::string& filename) {
+        in.open(filename, std::ios::binary);
+        remaining = 0;
+        if (!in.is_open()) return false;
+        in.read(reinterpret_cast<char*>(&remaining), sizeof(size_t));
+        return static_cast<bool>(in);
+    }
+    
+    bool next() {
+        if (remaining == 0) return false;
+        remaining--;
+        return InvertedIndex::readTermRecord(in, term, postings);
+    }
+};
+
+}
+
+SpimiIndexer::SpimiIndexer(size_t memory_budget, const std::string& temp_dir)
+    : memory_budget(memory_budget), temp_dir(temp_dir), run_count(0), vocab_size(0),
+      spill_failed(false) {}
+
+SpimiIndexer::~SpimiIndexer() {
+    for (const auto& run : runs) {
+        std::remove(run.c_str());
+    }
+}
+
+bool SpimiIndexer::checkMemoryBudget() {
+    if (!spill_failed && block.getPostingsMemoryUsage() >= memory_budget) {
+        spill_failed = !flushRun();
+    }
+    return !spill_failed;
+}
+
+bool SpimiIndexer::flushRun() {
+    if (block.getVocabularySize() == 0) return true;
+    
+    std::string filename = temp_dir + "/spimi_run_" + std::to_string(run_count) + ".bin";
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Cannot open run file for writing: " << filename << std::endl;
+        return false;
+    }
+    
+    block.savePostings(out);
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write run file: " << filename << std::endl;
+        std::remove(filename.c_str());
+        return false;
+    }
+    
+    std::cout << "Flushed run " << run_count << " (" << block.getVocabularySize() 
+              << " terms, ~" << block.getPostingsMemoryUsage() / (1024 * 1024) << " MB)"
+              << std::endl;
+    
+    runs.push_back(filename);
+    run_count++;
+    block.clearPostings();
+    return true;
+}
+
+bool SpimiIndexer::finish(const std::string& output_file) {
+    if (spill_failed || !flushRun()) return false;
+    return mergeRuns(output_file);
+}
+
+bool SpimiIndexer::mergeRange(size_t first, size_t last,
+                              const std::function<void(const std::string&,
+                                                       const PostingList&)>& emit) {
+    std::vector<std::unique_ptr<RunReader>> readers;
+    for (size_t r = first; r < last; ++r) {
+        readers.emplace_back(new RunReader());
+        if (!readers.back()->open(runs[r])) {
+            std::cerr << "Cannot open run file: " << runs[r] << std::endl;
+            return false;
+        }
+    }
+    
+    using HeapEntry = std::pair<std::string, size_t>;
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> heap;
+    for (size_t r = 0; r < readers.size(); ++r) {
+        if (readers[r]->next()) {
+            heap.emplace(readers[r]->term, r);
+        }
+    }
+    
+    std::vector<size_t> sources;
+    while (!heap.empty()) {
+        std::string term = heap.top().first;
+        sources.clear();
+        while (!heap.empty() && heap.top().first == term) {
+            sources.push_back(heap.top().second);
+            heap.pop();
+        }
+        
+        if (sources.size() == 1) {
+            emit(term, readers[sources[0]]->postings);
+        } else {
+            PostingList merged;
+            for (size_t r : sources) {
+                merged.append(readers[r]->postings);
+            }
+            emit(term, merged);
+        }
+        
+        for (size_t r : sources) {
+            if (readers[r]->next()) {
+                heap.emplace(readers[r]->term, r);
+            }
+        }
+    }
+    return true;
+}
+
+bool SpimiIndexer::mergeRangeToRun(size_t first, size_t last, const std::string& filename) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Cannot open run file for writing: " << filename << std::endl;
+        return false;
+    }
+    
+    // The term count is only known at the end.
+    size_t terms = 0;
+    out.write(reinterpret_cast<const char*>(&terms), sizeof(size_t));
+    bool merged = mergeRange(first, last, [&](const std::string& term, const PostingList& pl) {
+        InvertedIndex::writeTermRecord(out, term, pl);
+        terms++;
+    });
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&terms), sizeof(size_t));
+    out.close();
+    if (!merged || !out) {
+        if (merged) std::cerr << "Failed to write run file: " << filename << std::endl;
+        std::remove(filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool SpimiIndexer::mergeRuns(const std::string& output_file) {
+    size_t passes = 0;
+    while (runs.size() > MAX_MERGE_FAN_IN) {
+        std::vector<std::string> merged;
+        for (size_t first = 0; first < runs.size(); first += MAX_MERGE_FAN_IN) {
+            size_t last = std::min(runs.size(), first + MAX_MERGE_FAN_IN);
+            if (last - first == 1) {
+                merged.push_back(runs[first]);
+                continue;
+            }
+            
+            std::string filename = temp_dir + "/spimi_pass_" + std::to_string(passes) + "_" +
+                                   std::to_string(merged.size()) + ".bin";
+            if (!mergeRangeToRun(first, last, filename)) {
+                // Keep every file left in runs, so the destructor removes it.
+                merged.insert(merged.end(), runs.begin() + first, runs.end());
+                runs.swap(merged);
+                return false;
+            }
+            for (size_t r = first; r < last; ++r) {
+                std::remove(runs[r].c_str());
+            }
+            merged.push_back(filename);
+        }
+        
+        std::cout << "Merge pass " << passes << ": " << runs.size() << " runs into "
+                  << merged.size() << std::endl;
+        runs.swap(merged);
+        passes++;
+    }
+    
+    IndexWriter writer;
+    if (!writer.open(output_file)) return false;
+    writer.writeDocuments(block.getDocuments());
+    
+    if (!mergeRange(0, runs.size(), [&writer](const std::string& term, const PostingList& pl) {
+            writer.addTerm(term, pl);
+        })) {
+        return false;
+    }
+    
+    vocab_size = writer.getVocabularySize();
+    if (!writer.finish()) return false;
+    
+    std::cout << "Merged " << run_count << " runs into: " << output_file << std::endl;
+    return true;
+}
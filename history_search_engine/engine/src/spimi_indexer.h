@@ -0,0 +1,53 @@
+#ifndef SPIMI_INDEXER_H
+#define SPIMI_INDEXER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "inverted_index.h"
+
+// Single-pass in-memory indexing with a memory budget. Documents are added to
+// an in-memory InvertedIndex block; once its postings exceed the budget the
+// block is written to disk as a run sorted by term and the postings are
+// dropped. Doc IDs keep increasing across runs, so finish() can merge the
+// runs with a k-way merge on terms, concatenating postings in run order.
+// At most MAX_MERGE_FAN_IN runs are open at once; with more, neighbouring
+// runs are first merged into bigger runs in passes. The document table is
+// needed whole by the final file and stays in memory, outside the budget.
+class SpimiIndexer {
+private:
+    static constexpr size_t MAX_MERGE_FAN_IN = 64;
+    
+    size_t memory_budget;
+    std::string temp_dir;
+    InvertedIndex block;
+    std::vector<std::string> runs;
+    size_t run_count;
+    size_t vocab_size;
+    // A run could not be written; the index is incomplete.
+    bool spill_failed;
+    
+    bool flushRun();
+    bool mergeRuns(const std::string& output_file);
+    bool mergeRange(size_t first, size_t last,
+                    const std::function<void(const std::string&, const PostingList&)>& emit);
+    bool mergeRangeToRun(size_t first, size_t last, const std::string& filename);
+    
+public:
+    SpimiIndexer(size_t memory_budget, const std::string& temp_dir);
+    ~SpimiIndexer();
+    
+    InvertedIndex& getIndex() { return block; }
+    // Spills the block once it exceeds the budget. Returns false if the run
+    // could not be written; no more documents may be added then.
+    bool checkMemoryBudget();
+    bool failed() const { return spill_failed; }
+    bool finish(const std::string& output_file);
+    
+    size_t getRunCount() const { return run_count; }
+    size_t getVocabularySize() const { return vocab_size; }
+    size_t getTotalDocuments() const { return block.getTotalDocuments(); }
+};
+
+#endif
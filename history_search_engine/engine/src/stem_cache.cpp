@@ -0,0 +1,19 @@
+#include "stem_cache.h"
+
+StemCache::StemCache(size_t capacity)
+    : capacity(capacity), hits(0), misses(0) {}
+
+const std::string& StemCache::stem(std::string_view word) {
+    if (const std::string* cached = memo.get(word)) {
+        hits++;
+        return *cached;
+    }
+    
+    misses++;
+    std::string_view stem = word.substr(0, Stemmer::stemLength(word));
+    if (memo.size() >= capacity) {
+        uncached.assign(stem.data(), stem.size());
+        return uncached;
+    }
+    return *memo.try_emplace(word, stem).first;
+}
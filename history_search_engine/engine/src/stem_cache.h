@@ -0,0 +1,37 @@
+#ifndef STEM_CACHE_H
+#define STEM_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "hash_table.h"
+#include "stemmer.h"
+
+// Memo from surface form to stem in front of the Stemmer. Lookups hash the
+// word in place, so a hit allocates nothing. Under Zipf's law the frequent
+// words show up early, so once `capacity` words are cached new ones are
+// stemmed without being stored rather than evicting anything. Not
+// thread-safe: use one cache per thread.
+class StemCache {
+private:
+    HashTable<std::string> memo;
+    size_t capacity;
+    uint64_t hits;
+    uint64_t misses;
+    std::string uncached;
+    
+public:
+    static const size_t DEFAULT_CAPACITY = 1 << 17;
+    
+    explicit StemCache(size_t capacity = DEFAULT_CAPACITY);
+    
+    // The returned reference is valid until the next call.
+    const std::string& stem(std::string_view word);
+    
+    uint64_t getHits() const { return hits; }
+    uint64_t getMisses() const { return misses; }
+    size_t size() const { return memo.size(); }
+};
+
+#endif
@@ -1,169 +1,221 @@
 #include "stemmer.h"
+#include <cstdint>
 
-Stemmer::Stemmer() {
-    perfective = {
-        {"\xD0\xB2\xD1\x88\xD0\xB8\xD1\x81\xD1\x8C", 0},
-        {"\xD0\xB2\xD1\x88\xD0\xB8", 0},
-        {"\xD0\xB2", 0}
-    };
-    
-    reflexive = {
-        {"\xD1\x81\xD1\x8F", 0},
-        {"\xD1\x81\xD1\x8C", 0}
-    };
-    
-    adjective = {
-        {"\xD0\xB5\xD0\xB5", 0},
-        {"\xD0\xB8\xD0\xB5", 0},
-        {"\xD1\x8B\xD0\xB5", 0},
-        {"\xD0\xBE\xD0\xB5", 0},
-        {"\xD0\xB8\xD0\xBC\xD0\xB8", 0},
-        {"\xD1\x8B\xD0\xBC\xD0\xB8", 0},
-        {"\xD0\xB5\xD0\xB9", 0},
-        {"\xD0\xB8\xD0\xB9", 0},
-        {"\xD1\x8B\xD0\xB9", 0},
-        {"\xD0\xBE\xD0\xB9", 0},
-        {"\xD0\xB5\xD0\xBC", 0},
-        {"\xD0\xB8\xD0\xBC", 0},
-        {"\xD1\x8B\xD0\xBC", 0},
-        {"\xD0\xBE\xD0\xBC", 0},
-        {"\xD0\xB8\xD1\x85", 0},
-        {"\xD1\x8B\xD1\x85", 0},
-        {"\xD1\x83\xD1\x8E", 0},
-        {"\xD1\x8E\xD1\x8E", 0},
-        {"\xD0\xB0\xD1\x8F", 0},
-        {"\xD1\x8F\xD1\x8F", 0}
-    };
-    
-    participle = {
-        {"\xD0\xB5\xD0\xBC", 0},
-        {"\xD0\xBD\xD0\xBD", 0},
-        {"\xD1\x88", 0},
-        {"\xD1\x89", 0}
-    };
-    
-    verb = {
-        {"\xD1\x83\xD0\xB9\xD1\x82\xD0\xB5", 0},
-        {"\xD0\xB5\xD0\xB9\xD1\x82\xD0\xB5", 0},
-        {"\xD0\xB9\xD1\x82\xD0\xB5", 0},
-        {"\xD1\x83\xD1\x8E\xD1\x82", 0},
-        {"\xD1\x8E\xD1\x82", 0},
-        {"\xD1\x83\xD1\x8E", 0},
-        {"\xD1\x8E", 0}
-    };
-    
-    noun = {
-        {"\xD0\xB8\xD1\x8F\xD0\xBC\xD0\xB8", 0},
-        {"\xD1\x8C\xD0\xBC\xD0\xB8", 0},
-        {"\xD0\xB0\xD0\xBC\xD0\xB8", 0},
-        {"\xD0\xB8\xD0\xB5\xD0\xBC", 0},
-        {"\xD0\xB8\xD0\xB5\xD0\xB9", 0},
-        {"\xD0\xB8\xD1\x8F\xD1\x85", 0},
-        {"\xD0\xB8\xD1\x8F\xD0\xBC", 0},
-        {"\xD0\xB8\xD0\xB8", 0},
-        {"\xD0\xB8\xD1\x8F", 0},
-        {"\xD0\xB5\xD0\xB2", 0},
-        {"\xD0\xBE\xD0\xB2", 0},
-        {"\xD1\x8C\xD0\xB5", 0},
-        {"\xD1\x8C\xD1\x8F", 0},
-        {"\xD0\xB5\xD0\xB2", 0},
-        {"\xD0\xB0\xD0\xBC", 0},
-        {"\xD0\xB5\xD0\xBC", 0},
-        {"\xD0\xB0\xD1\x85", 0},
-        {"\xD1\x8C\xD1\x8E", 0},
-        {"\xD0\xB8\xD1\x8E", 0},
-        {"\xD0\xB5\xD0\xB9", 0},
-        {"\xD0\xB8\xD0\xB9", 0},
-        {"\xD0\xB8\xD0\xB5", 0},
-        {"\xD1\x8C\xD0\xB5", 0},
-        {"\xD0\xB5\xD0\xB5", 0},
-        {"\xD0\xBE", 0},
-        {"\xD0\xB0", 0},
-        {"\xD0\xB5", 0},
-        {"\xD0\xB8", 0},
-        {"\xD1\x8B", 0},
-        {"\xD1\x8C", 0},
-        {"\xD1\x8E", 0},
-        {"\xD1\x8F", 0}
+namespace {
+
+// Suffix groups of the Russian stemmer, in UTF-8.
+constexpr const char* PERFECTIVE[] = {
+    "\xD0\xB2\xD1\x88\xD0\xB8\xD1\x81\xD1\x8C",
+    "\xD0\xB2\xD1\x88\xD0\xB8",
+    "\xD0\xB2"
+};
+
+constexpr const char* REFLEXIVE[] = {
+    "\xD1\x81\xD1\x8F",
+    "\xD1\x81\xD1\x8C"
+};
+
+constexpr const char* ADJECTIVE[] = {
+    "\xD0\xB5\xD0\xB5",
+    "\xD0\xB8\xD0\xB5",
+    "\xD1\x8B\xD0\xB5",
+    "\xD0\xBE\xD0\xB5",
+    "\xD0\xB8\xD0\xBC\xD0\xB8",
+    "\xD1\x8B\xD0\xBC\xD0\xB8",
+    "\xD0\xB5\xD0\xB9",
+    "\xD0\xB8\xD0\xB9",
+    "\xD1\x8B\xD0\xB9",
+    "\xD0\xBE\xD0\xB9",
+    "\xD0\xB5\xD0\xBC",
+    "\xD0\xB8\xD0\xBC",
+    "\xD1\x8B\xD0\xBC",
+    "\xD0\xBE\xD0\xBC",
+    "\xD0\xB8\xD1\x85",
+    "\xD1\x8B\xD1\x85",
+    "\xD1\x83\xD1\x8E",
+    "\xD1\x8E\xD1\x8E",
+    "\xD0\xB0\xD1\x8F",
+    "\xD1\x8F\xD1\x8F"
+};
+
+constexpr const char* PARTICIPLE[] = {
+    "\xD0\xB5\xD0\xBC",
+    "\xD0\xBD\xD0\xBD",
+    "\xD1\x88",
+    "\xD1\x89"
+};
+
+constexpr const char* VERB[] = {
+    "\xD1\x83\xD0\xB9\xD1\x82\xD0\xB5",
+    "\xD0\xB5\xD0\xB9\xD1\x82\xD0\xB5",
+    "\xD0\xB9\xD1\x82\xD0\xB5",
+    "\xD1\x83\xD1\x8E\xD1\x82",
+    "\xD1\x8E\xD1\x82",
+    "\xD1\x83\xD1\x8E",
+    "\xD1\x8E"
+};
+
+constexpr const char* NOUN[] = {
+    "\xD0\xB8\xD1\x8F\xD0\xBC\xD0\xB8",
+    "\xD1\x8C\xD0\xBC\xD0\xB8",
+    "\xD0\xB0\xD0\xBC\xD0\xB8",
+    "\xD0\xB8\xD0\xB5\xD0\xBC",
+    "\xD0\xB8\xD0\xB5\xD0\xB9",
+    "\xD0\xB8\xD1\x8F\xD1\x85",
+    "\xD0\xB8\xD1\x8F\xD0\xBC",
+    "\xD0\xB8\xD0\xB8",
+    "\xD0\xB8\xD1\x8F",
+    "\xD0\xB5\xD0\xB2",
+    "\xD0\xBE\xD0\xB2",
+    "\xD1\x8C\xD0\xB5",
+    "\xD1\x8C\xD1\x8F",
+    "\xD0\xB5\xD0\xB2",
+    "\xD0\xB0\xD0\xBC",
+    "\xD0\xB5\xD0\xBC",
+    "\xD0\xB0\xD1\x85",
+    "\xD1\x8C\xD1\x8E",
+    "\xD0\xB8\xD1\x8E",
+    "\xD0\xB5\xD0\xB9",
+    "\xD0\xB8\xD0\xB9",
+    "\xD0\xB8\xD0\xB5",
+    "\xD1\x8C\xD0\xB5",
+    "\xD0\xB5\xD0\xB5",
+    "\xD0\xBE",
+    "\xD0\xB0",
+    "\xD0\xB5",
+    "\xD0\xB8",
+    "\xD1\x8B",
+    "\xD1\x8C",
+    "\xD1\x8E",
+    "\xD1\x8F"
+};
+
+constexpr const char* SUPERLATIVE[] = {
+    "\xD0\xB5\xD0\xB9\xD1\x88"
+};
+
+constexpr const char* DERIVATIONAL[] = {
+    "\xD0\xBE\xD1\x81\xD1\x82",
+    "\xD0\xBE\xD1\x81\xD1\x82\xD1\x8C"
+};
+
+// Reverse trie over the bytes of a suffix group, built at compile time.
+// Matching walks a word backwards from its end once and remembers the
+// deepest node that ends a suffix, i.e. the longest suffix of the group.
+template<size_t MaxNodes>
+struct SuffixTrie {
+    struct Node {
+        unsigned char byte = 0;
+        bool terminal = false;
+        uint16_t first_child = 0;
+        uint16_t next_sibling = 0;
     };
     
-    superlative = {
-        {"\xD0\xB5\xD0\xB9\xD1\x88", 0}
-    };
+    Node nodes[MaxNodes] = {};
+    size_t size = 1;
     
-    derivational = {
-        {"\xD0\xBE\xD1\x81\xD1\x82", 0},
-        {"\xD0\xBE\xD1\x81\xD1\x82\xD1\x8C", 0}
-    };
-}
-
-bool Stemmer::endsWith(const std::string& word, const std::string& suffix) const {
-    if (word.length() < suffix.length()) return false;
-    return word.substr(word.length() - suffix.length()) == suffix;
-}
-
-bool Stemmer::removeSuffix(std::string& word, const std::vector<Suffix>& suffixes) const {
-    for (const auto& suffix : suffixes) {
-        if (endsWith(word, suffix.text)) {
-            size_t new_len = word.length() - suffix.text.length();
-            if (new_len >= suffix.min_base_length) {
-                word = word.substr(0, new_len);
-                return true;
+    // Length of the longest suffix of word[0, end) in the group, 0 if none.
+    size_t longestMatch(const char* word, size_t end) const {
+        size_t node = 0;
+        size_t match = 0;
+        for (size_t i = end; i-- > 0;) {
+            unsigned char c = static_cast<unsigned char>(word[i]);
+            size_t child = nodes[node].first_child;
+            while (child && nodes[child].byte != c) {
+                child = nodes[child].next_sibling;
             }
+            if (!child) break;
+            
+            node = child;
+            if (nodes[node].terminal) match = end - i;
         }
+        return match;
     }
-    return false;
-}
+};
 
-bool Stemmer::isVowel(unsigned char c1, unsigned char c2) const {
-    if (c1 == 0xD0) {
-        return (c2 == 0xB0 || c2 == 0xB5 || c2 == 0xB8 || 
-                c2 == 0xBE || c2 == 0xB3 || c2 == 0xBB || c2 == 0xB8);
-    }
-    if (c1 == 0xD1) {
-        return (c2 == 0x8B || c2 == 0x8D || c2 == 0x8E || c2 == 0x8F);
+template<size_t N>
+constexpr size_t trieSize(const char* const (&suffixes)[N]) {
+    size_t bytes = 1;
+    for (const char* suffix : suffixes) {
+        while (*suffix++) bytes++;
     }
-    return false;
+    return bytes;
 }
 
-size_t Stemmer::findRV(const std::string& word) const {
-    for (size_t i = 0; i + 1 < word.length(); i += 2) {
-        if (isVowel(word[i], word[i + 1])) {
-            return i + 2;
+template<size_t MaxNodes, size_t N>
+constexpr SuffixTrie<MaxNodes> buildTrie(const char* const (&suffixes)[N]) {
+    static_assert(MaxNodes <= 0xFFFF, "suffix group too large");
+    SuffixTrie<MaxNodes> trie;
+    
+    for (const char* suffix : suffixes) {
+        size_t length = 0;
+        while (suffix[length]) length++;
+        
+        size_t node = 0;
+        for (size_t i = length; i-- > 0;) {
+            unsigned char c = static_cast<unsigned char>(suffix[i]);
+            size_t child = trie.nodes[node].first_child;
+            while (child && trie.nodes[child].byte != c) {
+                child = trie.nodes[child].next_sibling;
+            }
+            if (!child) {
+                child = trie.size++;
+                trie.nodes[child].byte = c;
+                trie.nodes[child].next_sibling = trie.nodes[node].first_child;
+                trie.nodes[node].first_child = static_cast<uint16_t>(child);
+            }
+            node = child;
         }
+        trie.nodes[node].terminal = true;
     }
-    return word.length();
+    return trie;
 }
 
-void Stemmer::removeI(std::string& word) const {
-    if (word.length() >= 2 && word[word.length() - 2] == '\xD0' && 
-        word[word.length() - 1] == '\xB8') {
-        word = word.substr(0, word.length() - 2);
-    }
+#define SUFFIX_TRIE(name, group) \
+    constexpr auto name = buildTrie<trieSize(group)>(group)
+
+SUFFIX_TRIE(perfective_trie, PERFECTIVE);
+SUFFIX_TRIE(reflexive_trie, REFLEXIVE);
+SUFFIX_TRIE(adjective_trie, ADJECTIVE);
+SUFFIX_TRIE(participle_trie, PARTICIPLE);
+SUFFIX_TRIE(verb_trie, VERB);
+SUFFIX_TRIE(noun_trie, NOUN);
+SUFFIX_TRIE(superlative_trie, SUPERLATIVE);
+SUFFIX_TRIE(derivational_trie, DERIVATIONAL);
+
+#undef SUFFIX_TRIE
+
+// Cuts the longest suffix of the group off word[0, length).
+template<typename Trie>
+bool removeSuffix(const Trie& trie, const char* word, size_t& length) {
+    size_t match = trie.longestMatch(word, length);
+    if (match == 0) return false;
+    length -= match;
+    return true;
 }
 
-std::string Stemmer::stem(const std::string& word) {
-    if (word.length() < 4) return word;
-    
-    std::string result = word;
+}
+
+size_t Stemmer::stemLength(std::string_view word) {
+    size_t length = word.length();
+    if (length < 4) return length;
     
-    removeSuffix(result, perfective);
+    const char* data = word.data();
+    removeSuffix(perfective_trie, data, length);
+    removeSuffix(reflexive_trie, data, length);
     
-    if (!removeSuffix(result, reflexive)) {
-        removeSuffix(result, reflexive);
+    if (removeSuffix(adjective_trie, data, length)) {
+        removeSuffix(participle_trie, data, length);
+    } else if (!removeSuffix(verb_trie, data, length)) {
+        removeSuffix(noun_trie, data, length);
     }
     
-    if (removeSuffix(result, adjective)) {
-        removeSuffix(result, participle);
-    } else {
-        if (!removeSuffix(result, verb)) {
-            removeSuffix(result, noun);
-        }
+    // Trailing "и".
+    if (length >= 2 && data[length - 2] == '\xD0' && data[length - 1] == '\xB8') {
+        length -= 2;
     }
+    removeSuffix(derivational_trie, data, length);
+    removeSuffix(superlative_trie, data, length);
     
-    removeI(result);
-    removeSuffix(result, derivational);
-    removeSuffix(result, superlative);
-    
-    return result;
+    return length;
 }
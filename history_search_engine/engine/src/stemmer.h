@@ -1,34 +1,16 @@
 #ifndef STEMMER_H
 #define STEMMER_H
 
-#include <string>
-#include <vector>
+#include <cstddef>
+#include <string_view>
 
+// Suffix-stripping stemmer for Russian. Every step only removes a suffix,
+// so the stem is always a prefix of the word; the suffix groups are matched
+// with reverse tries built at compile time (see stemmer.cpp).
 class Stemmer {
-private:
-    struct Suffix {
-        std::string text;
-        size_t min_base_length;
-    };
-    
-    std::vector<Suffix> perfective;
-    std::vector<Suffix> reflexive;
-    std::vector<Suffix> adjective;
-    std::vector<Suffix> participle;
-    std::vector<Suffix> verb;
-    std::vector<Suffix> noun;
-    std::vector<Suffix> superlative;
-    std::vector<Suffix> derivational;
-    
-    bool endsWith(const std::string& word, const std::string& suffix) const;
-    bool removeSuffix(std::string& word, const std::vector<Suffix>& suffixes) const;
-    bool isVowel(unsigned char c1, unsigned char c2) const;
-    size_t findRV(const std::string& word) const;
-    void removeI(std::string& word) const;
-    
 public:
-    Stemmer();
-    std::string stem(const std::string& word);
+    // Length of the stem of word; computed in place, without allocating.
+    static size_t stemLength(std::string_view word);
 };
 
 #endif
@@ -0,0 +1,70 @@
+#include "term_accumulator.h"
+#include "hash_table.h"
+#include <cstring>
+
+TermAccumulator::TermAccumulator() : mask(0) {
+    grow(64);
+}
+
+void TermAccumulator::grow(size_t min_capacity) {
+    size_t capacity = slots.size() ? slots.size() : 64;
+    while (capacity < min_capacity) {
+        capacity *= 2;
+    }
+    
+    std::vector<Slot> old_slots;
+    old_slots.swap(slots);
+    slots.assign(capacity, Slot{0, 0, 0, 0, 0});
+    mask = capacity - 1;
+    
+    for (uint32_t& idx : used) {
+        const Slot& slot = old_slots[idx];
+        size_t pos = slot.hash & mask;
+        while (slots[pos].count != 0) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = slot;
+        idx = static_cast<uint32_t>(pos);
+    }
+}
+
+void TermAccumulator::reset(size_t expected_terms) {
+    for (uint32_t idx : used) {
+        slots[idx].count = 0;
+    }
+    used.clear();
+    arena.clear();
+    
+    if (expected_terms * 2 > slots.size()) {
+        grow(expected_terms * 2);
+    }
+}
+
+uint32_t TermAccumulator::add(std::string_view term) {
+    if ((used.size() + 1) * 2 > slots.size()) {
+        grow(slots.size() * 2);
+    }
+    
+    uint64_t hash = hashString(term);
+    size_t pos = hash & mask;
+    
+    while (slots[pos].count != 0) {
+        Slot& slot = slots[pos];
+        if (slot.hash == hash && slot.length == term.size() &&
+            std::memcmp(arena.data() + slot.offset, term.data(), term.size()) == 0) {
+            slot.count++;
+            return slot.id;
+        }
+        pos = (pos + 1) & mask;
+    }
+    
+    Slot& slot = slots[pos];
+    slot.hash = hash;
+    slot.offset = static_cast<uint32_t>(arena.size());
+    slot.length = static_cast<uint32_t>(term.size());
+    slot.id = static_cast<uint32_t>(used.size());
+    slot.count = 1;
+    arena.insert(arena.end(), term.begin(), term.end());
+    used.push_back(static_cast<uint32_t>(pos));
+    return slot.id;
+}
@@ -0,0 +1,46 @@
+#ifndef TERM_ACCUMULATOR_H
+#define TERM_ACCUMULATOR_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Counts term occurrences within one document. Term bytes are copied into an
+// arena and counted in a small open-addressing table; reset() rewinds the
+// arena and clears only the slots that were used, so an accumulator reused
+// across documents stops allocating once it has seen its largest document.
+class TermAccumulator {
+private:
+    struct Slot {
+        uint64_t hash;
+        uint32_t offset;
+        uint32_t length;
+        uint32_t id;
+        int count;
+    };
+    
+    std::vector<char> arena;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> used;
+    size_t mask;
+    
+    void grow(size_t min_capacity);
+    
+public:
+    TermAccumulator();
+    void reset(size_t expected_terms);
+    // Returns the term's id: its index in first-occurrence order, which is
+    // also the order forEach() visits the terms in.
+    uint32_t add(std::string_view term);
+    size_t size() const { return used.size(); }
+    
+    template<typename Callback>
+    void forEach(Callback callback) const {
+        for (uint32_t idx : used) {
+            const Slot& slot = slots[idx];
+            callback(std::string_view(arena.data() + slot.offset, slot.length), slot.count);
+        }
+    }
+};
+
+#endif
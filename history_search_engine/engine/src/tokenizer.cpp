@@ -1,168 +1,119 @@
 #include "tokenizer.h"
+#include <array>
 
-Tokenizer::Tokenizer() : total_length(0) {
-    stats.total_tokens = 0;
-    stats.avg_length = 0.0;
-    stats.unique_count = 0;
-}
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-bool Tokenizer::isRussianByte(unsigned char c) const {
-    return (c >= 0xD0 && c <= 0xD1);
-}
+namespace {
 
-bool Tokenizer::isLatinLetter(char c) const {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
-}
+enum ByteClass : uint8_t {
+    BREAK,
+    LOWER,      // a-z
+    UPPER,      // A-Z
+    INNER,      // 0-9 and '-', only inside a word
+    LEAD        // first byte of a two-byte Cyrillic character
+};
 
-bool Tokenizer::isDigit(char c) const {
-    return c >= '0' && c <= '9';
+constexpr std::array<uint8_t, 256> makeClassTable() {
+    std::array<uint8_t, 256> table{};
+    for (int c = 'a'; c <= 'z'; ++c) table[c] = LOWER;
+    for (int c = 'A'; c <= 'Z'; ++c) table[c] = UPPER;
+    for (int c = '0'; c <= '9'; ++c) table[c] = INNER;
+    table['-'] = INNER;
+    table[0xD0] = LEAD;
+    table[0xD1] = LEAD;
+    return table;
 }
 
-std::string Tokenizer::toLower(const std::string& str) const {
-    std::string result;
-    result.reserve(str.length());
+constexpr std::array<uint8_t, 256> BYTE_CLASS = makeClassTable();
+
+// Index of the first byte in [i, n) that can start a word (a letter or a
+// Cyrillic lead byte), or n.
+size_t skipToWord(const unsigned char* text, size_t i, size_t n) {
+#ifdef __SSE2__
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i a = _mm_set1_epi8('a');
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i letters = _mm_set1_epi8(static_cast<char>(26 - 0x80));
+    const __m128i lead_d0 = _mm_set1_epi8(static_cast<char>(0xD0));
+    const __m128i lead_d1 = _mm_set1_epi8(static_cast<char>(0xD1));
     
-    for (size_t i = 0; i < str.length(); ++i) {
-        unsigned char c = str[i];
-        
-        if (c >= 'A' && c <= 'Z') {
-            result += (c + 32);
-        }
-        else if (i + 1 < str.length()) {
-            unsigned char next = str[i + 1];
-            
-            if (c == 0xD0 && next >= 0x90 && next <= 0xAF) {
-                result += c;
-                result += (next + 0x20);
-                ++i;
-            }
-            else if (c == 0xD0 && next == 0x81) {
-                result += "\xD1\x91";
-                ++i;
-            }
-            else {
-                result += c;
-                if (isRussianByte(c)) {
-                    result += next;
-                    ++i;
-                }
-            }
-        }
-        else {
-            result += c;
-        }
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        // (c | 0x20) - 'a' < 26 as unsigned, via a biased signed compare.
+        __m128i offset = _mm_sub_epi8(_mm_or_si128(bytes, case_bit), a);
+        __m128i is_letter = _mm_cmplt_epi8(_mm_xor_si128(offset, bias), letters);
+        __m128i is_lead = _mm_or_si128(_mm_cmpeq_epi8(bytes, lead_d0),
+                                       _mm_cmpeq_epi8(bytes, lead_d1));
+        int mask = _mm_movemask_epi8(_mm_or_si128(is_letter, is_lead));
+        if (mask) return i + __builtin_ctz(mask);
     }
-    
-    return result;
+#endif
+    for (; i < n; ++i) {
+        uint8_t cls = BYTE_CLASS[text[i]];
+        if (cls == LOWER || cls == UPPER || cls == LEAD) return i;
+    }
+    return n;
 }
 
-std::vector<Token> Tokenizer::tokenize(const std::string& text) {
-    std::vector<Token> tokens;
-    std::string current;
-    size_t position = 0;
-    size_t i = 0;
+}
+
+Tokenizer::Tokenizer() : in_word(false), word_start(0) {}
+
+bool Tokenizer::scanWord(std::string_view text, size_t offset, size_t& i) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    size_t n = text.size();
+    
+    if (!in_word) {
+        i = skipToWord(bytes, i, n);
+        if (i == n) return false;
+        in_word = true;
+        word_start = offset + i;
+        buffer.clear();
+    }
     
-    while (i < text.length()) {
-        unsigned char c = text[i];
+    while (i < n) {
+        unsigned char c = bytes[i];
+        uint8_t cls = BYTE_CLASS[c];
         
-        if (c <= 32 || c == ',' || c == '.' || c == '!' || c == '?' ||
-            c == ';' || c == ':' || c == '"' || c == '\'' || c == '(' ||
-            c == ')' || c == '[' || c == ']' || c == '{' || c == '}' ||
-            c == '<' || c == '>' || c == '/' || c == '\\' || c == '|' ||
-            c == '=' || c == '+' || c == '*' || c == '&') {
-            
-            if (current.length() >= 2) {
-                bool is_number = true;
-                for (char ch : current) {
-                    if (!isDigit(ch)) {
-                        is_number = false;
-                        break;
-                    }
-                }
-                
-                if (!is_number) {
-                    Token token;
-                    token.text = toLower(current);
-                    token.position = position;
-                    tokens.push_back(token);
-                    
-                    total_length += token.text.length();
-                }
-            }
-            
-            current.clear();
-            position = i + 1;
+        if (cls == LOWER || cls == INNER) {
+            buffer += static_cast<char>(c);
             ++i;
-            continue;
-        }
-        
-        if (c == 0xD0 || c == 0xD1) {
-            if (i + 1 < text.length()) {
-                current += text[i];
-                current += text[i + 1];
-                i += 2;
-            } else {
-                ++i;
-            }
-        }
-        else if (isLatinLetter(c) || (isDigit(c) && !current.empty()) || 
-                 (c == '-' && !current.empty())) {
-            current += text[i];
+        } else if (cls == UPPER) {
+            buffer += static_cast<char>(c + 32);
             ++i;
-        }
-        else {
-            if (current.length() >= 2) {
-                bool is_number = true;
-                for (char ch : current) {
-                    if (!isDigit(ch)) {
-                        is_number = false;
-                        break;
-                    }
-                }
-                
-                if (!is_number) {
-                    Token token;
-                    token.text = toLower(current);
-                    token.position = position;
-                    tokens.push_back(token);
-                    
-                    total_length += token.text.length();
-                }
+        } else if (cls == LEAD) {
+            if (i + 1 == n) {
+                ++i;
+                return true;
             }
-            
-            current.clear();
-            position = i + 1;
-            ++i;
-        }
-    }
-    
-    if (current.length() >= 2) {
-        bool is_number = true;
-        for (char ch : current) {
-            if (!isDigit(ch)) {
-                is_number = false;
-                break;
+            unsigned char next = bytes[i + 1];
+            if (c == 0xD0 && next >= 0x90 && next <= 0x9F) {
+                // А-П -> а-п
+                buffer += '\xD0';
+                buffer += static_cast<char>(next + 0x20);
+            } else if (c == 0xD0 && next >= 0xA0 && next <= 0xAF) {
+                // Р-Я -> р-я
+                buffer += '\xD1';
+                buffer += static_cast<char>(next - 0x20);
+            } else if (c == 0xD0 && next == 0x81) {
+                // Ё -> ё
+                buffer += "\xD1\x91";
+            } else {
+                buffer += static_cast<char>(c);
+                buffer += static_cast<char>(next);
             }
+            i += 2;
+        } else {
+            return true;
         }
-        
-        if (!is_number) {
-            Token token;
-            token.text = toLower(current);
-            token.position = position;
-            tokens.push_back(token);
-            
-            total_length += token.text.length();
-        }
-    }
-    
-    stats.total_tokens += tokens.size();
-    if (stats.total_tokens > 0) {
-        stats.avg_length = static_cast<double>(total_length) / stats.total_tokens;
     }
-    
-    return tokens;
+    return false;
 }
 
-TokenizerStats Tokenizer::getStats() const {
-    return stats;
+bool Tokenizer::closeWord() {
+    if (!in_word) return false;
+    in_word = false;
+    return buffer.length() >= 2;
 }
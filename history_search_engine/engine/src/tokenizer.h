@@ -1,34 +1,55 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <vector>
-
-struct Token {
-    std::string text;
-    size_t position;
-};
-
-struct TokenizerStats {
-    size_t total_tokens;
-    double avg_length;
-    size_t unique_count;
-};
+#include <string_view>
 
+// Splits text into lower-cased words of Latin and Cyrillic letters (digits
+// and '-' may continue a word) of at least two bytes. Bytes are classified
+// with a 256-entry table, and runs of bytes that cannot start a word are
+// skipped 16 at a time with SSE2.
+//
+// Text can also be pushed in runs with feed(): a word left open at the end
+// of a run continues into the next one until endWord() or a break byte.
 class Tokenizer {
 private:
-    TokenizerStats stats;
-    size_t total_length;
+    // The current word, case-folded.
+    std::string buffer;
+    bool in_word;
+    size_t word_start;
     
-    bool isRussianByte(unsigned char c) const;
-    bool isLatinLetter(char c) const;
-    bool isDigit(char c) const;
-    std::string toLower(const std::string& str) const;
+    // Advances i through text, which starts at byte `offset` of the input.
+    // Returns true when a word ends at i, false when text runs out first.
+    bool scanWord(std::string_view text, size_t offset, size_t& i);
+    // Ends the current word; true if it is long enough to be a token.
+    bool closeWord();
     
 public:
     Tokenizer();
-    std::vector<Token> tokenize(const std::string& text);
-    TokenizerStats getStats() const;
+    
+    // Calls sink(std::string_view token, size_t position) for every token
+    // completed within text; position is the byte offset of its start.
+    // The view points into a buffer that the next token overwrites.
+    template<typename Sink>
+    void feed(std::string_view text, size_t offset, Sink&& sink) {
+        size_t i = 0;
+        while (scanWord(text, offset, i)) {
+            endWord(sink);
+        }
+    }
+    
+    template<typename Sink>
+    void endWord(Sink&& sink) {
+        if (closeWord()) sink(std::string_view(buffer), word_start);
+    }
+    
+    template<typename Sink>
+    void forEachToken(std::string_view text, Sink sink) {
+        feed(text, 0, sink);
+        endWord(sink);
+    }
 };
 
 #endif
@@ -7,15 +7,17 @@
 ZipfAnalyzer::ZipfAnalyzer() : total_terms(0) {}
 
 void ZipfAnalyzer::addTerm(const std::string& term) {
-    int count = 0;
-    if (term_counts.find(term, count)) {
-        term_counts.insert(term, count + 1);
-    } else {
-        term_counts.insert(term, 1);
-    }
+    term_counts[term]++;
     total_terms++;
 }
 
+void ZipfAnalyzer::merge(const ZipfAnalyzer& other) {
+    other.term_counts.iterate([this](const std::string& term, const int& freq) {
+        term_counts[term] += freq;
+    });
+    total_terms += other.total_terms;
+}
+
 void ZipfAnalyzer::saveToCSV(const std::string& filename) {
     std::vector<TermFrequency> frequencies;
     
@@ -28,7 +30,8 @@ void ZipfAnalyzer::saveToCSV(const std::string& filename) {
     
     std::sort(frequencies.begin(), frequencies.end(),
               [](const TermFrequency& a, const TermFrequency& b) {
-                  return a.frequency > b.frequency;
+                  if (a.frequency != b.frequency) return a.frequency > b.frequency;
+                  return a.term < b.term;
               });
     
     std::ofstream out(filename);
@@ -18,6 +18,7 @@ private:
 public:
     ZipfAnalyzer();
     void addTerm(const std::string& term);
+    void merge(const ZipfAnalyzer& other);
     void saveToCSV(const std::string& filename);
     void printStatistics();
 };
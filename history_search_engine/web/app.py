@@ -1,17 +1,70 @@
 from flask import Flask, render_template, request, jsonify
 from pymongo import MongoClient
+import json
+import os
 import re
+import urllib.error
+import urllib.parse
+import urllib.request
 
 app = Flask(__name__)
 
 client = MongoClient('mongodb://mongodb:27017/')
 db = client['history_search']
 collection = db['documents']
+# Snippets are looked up by the URLs the search server returns.
+collection.create_index('url')
 
-def highlight_text(text, query):
-    pattern = re.compile(f'({re.escape(query)})', re.IGNORECASE)
+SEARCH_SERVER = os.environ.get('SEARCH_SERVER', 'http://search_server:8080')
+SEARCH_TIMEOUT = 10
+
+QUERY_OPERATORS = {'AND', 'OR', 'NOT'}
+
+# Returns the decoded answer and the HTTP status to pass on: the server's
+# own status for its errors, 503 when it cannot be reached and 502 when its
+# answer is not JSON.
+def ask_search_server(path, **params):
+    url = f'{SEARCH_SERVER}{path}?{urllib.parse.urlencode(params)}'
+    try:
+        with urllib.request.urlopen(url, timeout=SEARCH_TIMEOUT) as response:
+            return json.load(response), 200
+    except urllib.error.HTTPError as e:
+        try:
+            found = json.load(e)
+        except ValueError:
+            found = {}
+        return {'error': found.get('error', f'search server error {e.code}')}, e.code
+    except (urllib.error.URLError, TimeoutError) as e:
+        return {'error': f'search server unavailable: {e}'}, 503
+    except ValueError:
+        return {'error': 'invalid answer from search server'}, 502
+
+def query_words(query):
+    words = re.findall(r'\w+', query)
+    return [w for w in words if w not in QUERY_OPERATORS and not w.startswith('NEAR')]
+
+def highlight_text(text, words):
+    if not words:
+        return text
+    pattern = re.compile('(' + '|'.join(re.escape(w) for w in words) + ')', re.IGNORECASE)
     return pattern.sub(r'<mark>\1</mark>', text)
 
+def make_snippet(text, words):
+    lower = text.lower()
+    positions = [p for p in (lower.find(w.lower()) for w in words) if p != -1]
+    if positions:
+        pos = min(positions)
+        start = max(0, pos - 100)
+        end = min(len(text), pos + 150)
+        snippet = text[start:end]
+        if start > 0:
+            snippet = '...' + snippet
+        if end < len(text):
+            snippet = snippet + '...'
+    else:
+        snippet = text[:200] + '...'
+    return highlight_text(snippet, words)
+
 def strip_html(html):
     clean = re.sub('<[^<]+?>', ' ', html)
     clean = re.sub(r'\s+', ' ', clean)
@@ -28,60 +81,47 @@ def search():
     per_page = 10
     
     if not query:
-        return jsonify({'results': [], 'total': 0, 'page': page})
-    
-    regex = {'$regex': query, '$options': 'i'}
-    
-    total = collection.count_documents({'html_content': regex})
+        return jsonify({'results': [], 'total': 0, 'total_exact': True, 'page': page})
     
-    skip = (page - 1) * per_page
+    found, status = ask_search_server('/search', q=query, page=page, per_page=per_page)
+    if status != 200:
+        return jsonify(found), status
     
-    cursor = collection.find(
-        {'html_content': regex},
-        {'url': 1, 'html_content': 1, 'source': 1, '_id': 0}
-    ).skip(skip).limit(per_page)
+    urls = [r['url'] for r in found['results']]
+    html = {
+        doc['url']: doc['html_content']
+        for doc in collection.find({'url': {'$in': urls}}, {'url': 1, 'html_content': 1, '_id': 0})
+    }
     
+    words = query_words(query)
     results = []
-    for doc in cursor:
-        text = strip_html(doc['html_content'])
-        
-        pos = text.lower().find(query.lower())
-        if pos != -1:
-            start = max(0, pos - 100)
-            end = min(len(text), pos + 150)
-            snippet = text[start:end]
-            if start > 0:
-                snippet = '...' + snippet
-            if end < len(text):
-                snippet = snippet + '...'
-        else:
-            snippet = text[:200] + '...'
-        
-        snippet = highlight_text(snippet, query)
-        
+    for r in found['results']:
+        text = strip_html(html.get(r['url'], ''))
         results.append({
-            'url': doc['url'],
-            'snippet': snippet,
-            'source': doc.get('source', 'unknown')
+            'url': r['url'],
+            'snippet': make_snippet(text, words),
+            'source': r['source'],
+            'score': r['score']
         })
     
     return jsonify({
         'results': results,
-        'total': total,
-        'page': page,
-        'pages': (total + per_page - 1) // per_page
+        'total': found['total'],
+        'total_exact': found['total_exact'],
+        'warning': found.get('warning'),
+        'page': found['page'],
+        'pages': found['pages']
     })
 
 @app.route('/api/stats')
 def stats():
-    total_docs = collection.count_documents({})
-    sources = collection.aggregate([
-        {'$group': {'_id': '$source', 'count': {'$sum': 1}}}
-    ])
+    found, status = ask_search_server('/stats')
+    if status != 200:
+        return jsonify(found), status
     
     return jsonify({
-        'total_documents': total_docs,
-        'sources': list(sources)
+        'total_documents': found['documents'],
+        'sources': [{'_id': s['source'], 'count': s['documents']} for s in found['sources']]
     })
 
 if __name__ == '__main__':